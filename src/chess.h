@@ -5,6 +5,7 @@
 #define CHESS_H
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,6 +13,16 @@ extern "C" {
 
 typedef signed char chess_value_t;
 
+/// @brief Define as 0 to leave the running evaluation out of chess_game_t, which saves a little work on every move. chess_evaluate() then scans the board instead. The library and everything that uses it must agree on this
+#ifndef CHESS_EVALUATION
+#define CHESS_EVALUATION 1
+#endif
+
+/// @brief The number of earlier position keys chess_game_t keeps for finding repetitions, which is 0 or a power of two no larger than 128. The default of 128 covers the whole 100 ply window of the fifty move rule, for 1KB a game. Define it smaller to save space at the cost of missing repetitions further back, or as 0 to leave the keys out, in which case no repetitions are found. The library and everything that uses it must agree on it
+#ifndef CHESS_HISTORY_SIZE
+#define CHESS_HISTORY_SIZE 128
+#endif
+
 /// @brief The type of chess piece
 typedef enum {
     CHESS_PAWN = 0,
@@ -31,11 +42,19 @@ typedef enum {
     /// @brief A king is in checkmate
     CHESS_CHECKMATE  = 2,
     /// @brief The game is a stalemate
-    CHESS_STALEMATE = 3
+    CHESS_STALEMATE = 3,
+    /// @brief The game is drawn because the position has come up three times
+    CHESS_DRAW_REPETITION = 4,
+    /// @brief The game is drawn because fifty moves have gone by without a capture or a pawn move
+    CHESS_DRAW_FIFTY_MOVES = 5
 } chess_status_t;
 
 /// @brief A result code
 typedef enum {
+    /// @brief A queue was full. Try again once some of it has been worked through
+    CHESS_BUSY = -3,
+    /// @brief There wasn't enough memory
+    CHESS_OUT_OF_MEMORY = -2,
     /// @brief An invalid argument was passed
     CHESS_INVALID = -1,
     /// @brief The operation completed successfully
@@ -55,26 +74,160 @@ typedef chess_value_t chess_id_t;
 /// @brief A chess score value
 typedef unsigned int chess_score_t;
 
+/// @brief A move packed into 16 bits. See CHESS_MOVE_FROM(), CHESS_MOVE_TO() and CHESS_MOVE_FLAGS()
+typedef uint16_t chess_move_t;
+
+/// @brief The kind of a packed move
+typedef enum {
+    /// @brief A regular move or capture
+    CHESS_MOVE_NORMAL = 0,
+    /// @brief A pawn advancing two squares from its starting rank
+    CHESS_MOVE_DOUBLE_PUSH = 1,
+    /// @brief A castle. The move is the king's, two squares toward the rook it castles with
+    CHESS_MOVE_CASTLE = 2,
+    /// @brief A pawn capturing en passant
+    CHESS_MOVE_EN_PASSANT = 3,
+    /// @brief A pawn reaching the last rank and promoting to a bishop
+    CHESS_MOVE_PROMOTE_BISHOP = 4,
+    /// @brief A pawn reaching the last rank and promoting to a rook
+    CHESS_MOVE_PROMOTE_ROOK = 5,
+    /// @brief A pawn reaching the last rank and promoting to a knight
+    CHESS_MOVE_PROMOTE_KNIGHT = 6,
+    /// @brief A pawn reaching the last rank and promoting to a queen
+    CHESS_MOVE_PROMOTE_QUEEN = 7
+} chess_move_flags_t;
+
+/// @brief The castle rights, as bit flags
+typedef enum {
+    /// @brief No castling is possible
+    CHESS_CASTLE_NONE = 0,
+    /// @brief White may castle on the king side
+    CHESS_CASTLE_WHITE_KING_SIDE = 1,
+    /// @brief White may castle on the queen side
+    CHESS_CASTLE_WHITE_QUEEN_SIDE = 2,
+    /// @brief Black may castle on the king side
+    CHESS_CASTLE_BLACK_KING_SIDE = 4,
+    /// @brief Black may castle on the queen side
+    CHESS_CASTLE_BLACK_QUEEN_SIDE = 8,
+    /// @brief Every castle is possible
+    CHESS_CASTLE_ALL = 15
+} chess_castle_rights_t;
+
+/// @brief The most moves a position can produce
+#define CHESS_MAX_MOVES 256
+
+/// @brief The longest string chess_to_fen() writes, including the terminator
+#define CHESS_MAX_FEN 100
+
+/// @brief The size of a packed position, in bytes
+#define CHESS_PACKED_SIZE 24
+
+/// @brief A position packed into CHESS_PACKED_SIZE bytes. See chess_pack()
+typedef struct {
+    /// @brief The packed position
+    uint8_t bytes[CHESS_PACKED_SIZE];
+} chess_packed_t;
+
+/// @brief A list of packed moves
+typedef struct {
+    /// @brief The moves
+    chess_move_t moves[CHESS_MAX_MOVES];
+    /// @brief The number of moves in the list
+    size_t size;
+} chess_move_list_t;
+
 /// @brief The state for the chess game (effectively private)
 typedef struct {
     /// @brief The board, each containing an id
     chess_id_t board[64];
+    /// @brief The occupancy of each piece type, one bit per board index
+    uint64_t pieces[6];
+    /// @brief The occupancy of each team, one bit per board index
+    uint64_t teams[2];
+    /// @brief The Zobrist key of the position
+    uint64_t hash;
     /// @brief The location of each king
     chess_index_t kings[2];
-    /// @brief Targets for possible en passant captures
-    chess_index_t en_passant_targets[16];
+    /// @brief The square a pawn that just advanced two squares passed over, if it can be taken en passant, otherwise CHESS_NONE
+    chess_index_t en_passant;
     /// @brief Which turn it is
     chess_team_t turn;
-    /// @brief Indicates that no castling can take place
-    bool no_castle[2];
+    /// @brief The castle rights that remain, as chess_castle_rights_t flags
+    uint8_t castle_rights;
+#if CHESS_EVALUATION
+    /// @brief The game phase, which is 24 with every piece on the board and falls toward 0 as pieces other than pawns come off
+    uint8_t phase;
+    /// @brief The middlegame and endgame evaluation from white's side, in hundredths of a pawn, kept up to date as pieces move
+    int16_t evaluation[2];
+#endif
     /// @brief Indicates the current scores
     chess_score_t score[2];
+    /// @brief The plies since the last capture or pawn move
+    uint16_t halfmove;
+    /// @brief The move number, starting at 1 and going up after each black move
+    uint16_t fullmove;
+#if CHESS_HISTORY_SIZE
+    /// @brief Where the next key goes in history
+    uint8_t history_top;
+    /// @brief How many keys in history are valid
+    uint8_t history_count;
+    /// @brief The keys of the positions before this one, as a ring ending just before history_top
+    uint64_t history[CHESS_HISTORY_SIZE];
+#endif
 } chess_game_t;
 
+/// @brief What chess_unmake_move() needs to take back a move made with chess_make_move()
+typedef struct {
+    /// @brief The move that was made
+    chess_move_t move;
+    /// @brief The id of the captured piece, or CHESS_NONE if nothing was captured
+    chess_id_t captured;
+    /// @brief The en passant square before the move
+    chess_index_t en_passant;
+    /// @brief The castle rights before the move
+    uint8_t castle_rights;
+    /// @brief The moving team's score before the move
+    chess_score_t score;
+    /// @brief The Zobrist key before the move
+    uint64_t hash;
+    /// @brief The halfmove clock before the move
+    uint16_t halfmove;
+#if CHESS_HISTORY_SIZE
+    /// @brief The number of valid keys in the history before the move
+    uint8_t history_count;
+    /// @brief The history key the move overwrote, once the ring is full
+    uint64_t history_key;
+#endif
+} chess_undo_t;
+
 /// @brief Initializes a new chess game
+/// @remarks The first call also builds the shared attack tables, so make it before sharing games between threads
 /// @param out_game The structure holding the game
 void chess_init(chess_game_t* out_game);
+/// @brief Sets up a game from a position in Forsyth-Edwards Notation
+/// @remarks The move counters are optional, and default to 0 and 1. The history starts out empty, so repetitions are only found among the moves made after this. Each team's score is the value of the opponent's pieces missing from a full set
+/// @param out_game The structure holding the game
+/// @param fen The position, such as "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"
+/// @return CHESS_SUCCESS if the position was loaded, otherwise CHESS_INVALID, in which case out_game is left as it was
+chess_result_t chess_from_fen(chess_game_t* out_game, const char* fen);
+/// @brief Writes the current position in Forsyth-Edwards Notation
+/// @param game The game
+/// @param out_buffer A string buffer of at least CHESS_MAX_FEN characters
+/// @return CHESS_SUCCESS if the operation was successful, otherwise CHESS_INVALID if invalid argument
+chess_result_t chess_to_fen(const chess_game_t* game, char* out_buffer);
+/// @brief Packs a position into CHESS_PACKED_SIZE bytes
+/// @remarks The first 8 bytes are the occupied squares, one bit per board index. They are followed by a 4-bit code for each occupied square in index order, low nibble first. The codes are the piece ids, plus a rook that can still castle, a pawn that can be taken en passant, and a black king when black is up. The scores aren't kept, and are worked out again on unpacking, as with chess_from_fen(). Neither are the move counters or the history
+/// @param game The game to pack
+/// @param out_packed The packed position
+/// @return CHESS_SUCCESS if the operation was successful, otherwise CHESS_INVALID if invalid argument, a king is missing or there are more than 32 pieces on the board
+chess_result_t chess_pack(const chess_game_t* game, chess_packed_t* out_packed);
+/// @brief Sets up a game from a position packed with chess_pack()
+/// @param out_game The game to set up. It is left untouched on failure
+/// @param packed The packed position
+/// @return CHESS_SUCCESS if the operation was successful, otherwise CHESS_INVALID if invalid argument or the packed position is invalid
+chess_result_t chess_unpack(chess_game_t* out_game, const chess_packed_t* packed);
 /// @brief Moves a piece from one position to another
+/// @remarks To castle, move the king two squares toward the rook, or onto the rook itself
 /// @param game the chess game  
 /// @param index_from The index to move from
 /// @param index_to The index to move to.
@@ -86,6 +239,18 @@ chess_index_t chess_move(chess_game_t* game, chess_index_t index_from, chess_ind
 /// @param out_moves The moves array to write to (should be at least 64 length)
 /// @return The count of moves written
 size_t chess_compute_moves(const chess_game_t* game, chess_index_t index, chess_index_t* out_moves);
+/// @brief Computes where a piece on the board can move, as a mask
+/// @remarks Bit n of the result is set if the piece can move to index n, so checking a destination is a single bit test. A king that can castle includes the square two over toward the rook
+/// @param game The chess game
+/// @param index The index on the board for the piece to compute
+/// @return The mask of legal destinations, or 0 if invalid argument, the piece can't move, or it isn't its team's turn
+uint64_t chess_legal_destinations(const chess_game_t* game, chess_index_t index);
+/// @brief Computes where each piece of the team that is up can move, as masks
+/// @remarks This is quicker than calling chess_legal_destinations() for each piece, since the check and pin analysis is only done once
+/// @param game The chess game
+/// @param out_masks The 64 masks to fill, one for each board index, as from chess_legal_destinations(). Empty squares and the other team's pieces get 0
+/// @return The number of pieces that can move, or 0 if invalid argument
+size_t chess_legal_destination_map(const chess_game_t* game, uint64_t* out_masks);
 /// @brief Indicates whether an array of move destinations contains the specified index
 /// @param moves The moves array
 /// @param moves_size The size of the moves array
@@ -99,6 +264,7 @@ bool chess_contains_move(const chess_index_t* moves, size_t moves_size, chess_in
 /// @return CHESS_SUCCESS if the promotion was successful, otherwise CHESS_INVALID
 chess_result_t chess_promote_pawn(chess_game_t* game, chess_index_t index, chess_type_t new_type);
 /// @brief Indicates the status of the game
+/// @remarks Check is worked out once for each side, and the search for a legal move stops at the first one found. A draw by repetition or by the fifty move rule is reported to both sides as soon as it could be claimed, though checkmate and stalemate come first
 /// @param game The game
 /// @param out_white_status The white status
 /// @param out_black_status The black status
@@ -123,12 +289,79 @@ chess_result_t chess_index_name(chess_index_t index, char* out_buffer);
 /// @param team The team to return the score for
 /// @return The score for the team
 chess_score_t chess_score(const chess_game_t* game, chess_team_t team);
+/// @brief Indicates what a piece type is worth when it's captured
+/// @param type The piece type
+/// @return The value of the piece type, or 0 if type is invalid
+chess_score_t chess_type_score(chess_type_t type);
+/// @brief Evaluates the position by material and by where each piece stands
+/// @remarks The middlegame and endgame piece-square tables are blended by how much material is left. The evaluation is kept up to date as moves are made, so this costs almost nothing, unless CHESS_EVALUATION is 0, in which case it scans the board
+/// @param game The game
+/// @return The evaluation for the team that is up, in hundredths of a pawn, or 0 if invalid argument
+int chess_evaluate(const chess_game_t* game);
+/// @brief Works out the material won or lost by a capture, once both sides have traded off every piece they'd want to on the square
+/// @remarks The pieces bearing on the square are collected once, along with those lined up behind them, and the least valuable one always takes next. Pins are not considered. The piece values are those from chess_type_score(), and a pawn reaching the end of the board counts as a queen
+/// @param game The game
+/// @param index_from The index of the piece making the first capture
+/// @param index_to The index it moves to. If nothing is there, this reports what moving there would lose
+/// @return The net gain for the team of the piece at index_from, or 0 if invalid argument
+int chess_see(const chess_game_t* game, chess_index_t index_from, chess_index_t index_to);
 
 /// @brief Indicates whether or not a team's king can castle
+/// @remarks This reports the castle rights the team has left, whether or not a castle is legal right now
 /// @param game The game
 /// @param team The team to return the castle status for
 /// @return True if the team's king can castle, otherwise false
 bool chess_can_castle(const chess_game_t* game, chess_team_t team);
+/// @brief Retrieves the castle rights for both teams
+/// @param game The game
+/// @return The castle rights that remain, as chess_castle_rights_t flags
+chess_castle_rights_t chess_castle_rights(const chess_game_t* game);
+/// @brief Generates every legal move for the team whose turn it is
+/// @remarks A pawn move onto the last rank is listed once for each piece it can promote to
+/// @param game The game
+/// @param out_moves The list to fill
+/// @return The number of moves generated
+size_t chess_generate_moves(const chess_game_t* game, chess_move_list_t* out_moves);
+/// @brief Indicates whether the team whose turn it is has any legal move
+/// @remarks This stops at the first legal move it finds, so it's much cheaper than generating them all
+/// @param game The game
+/// @return True if there is at least one legal move, otherwise false
+bool chess_has_legal_move(const chess_game_t* game);
+/// @brief Counts the legal moves for the team whose turn it is, without listing them
+/// @param game The game
+/// @return The number of moves chess_generate_moves() would generate
+size_t chess_count_legal_moves(const chess_game_t* game);
+/// @brief Makes a move from chess_generate_moves() so that it can be taken back with chess_unmake_move()
+/// @remarks The move isn't checked for legality. Use chess_move() for moves that haven't been generated for the current position
+/// @param game The game
+/// @param move The packed move
+/// @param out_undo The record to fill for chess_unmake_move(), or NULL
+/// @return The index of the capture victim if successful. -1/CHESS_NONE if no capture. -2 on invalid arguments
+chess_index_t chess_make_move(chess_game_t* game, chess_move_t move, chess_undo_t* out_undo);
+/// @brief Takes back the last move made with chess_make_move()
+/// @param game The game
+/// @param undo The record filled in by chess_make_move()
+void chess_unmake_move(chess_game_t* game, const chess_undo_t* undo);
+/// @brief Retrieves a 64-bit Zobrist key identifying the position
+/// @remarks The key covers the pieces, the team that is up, the castle rights and the en passant square. It is kept up to date as moves are made, so this is cheap
+/// @param game The game
+/// @return The key, or 0 if game is NULL
+uint64_t chess_hash(const chess_game_t* game);
+/// @brief Indicates how many plies have been played since the last capture or pawn move
+/// @param game The game
+/// @return The halfmove clock, or 0 if game is NULL
+unsigned int chess_halfmove_clock(const chess_game_t* game);
+/// @brief Counts the earlier times the current position came up with the same team to move
+/// @remarks Only the positions since the last capture or pawn move are compared, since nothing before one can come up again, and each takes a single compare of the keys. Positions further back than CHESS_HISTORY_SIZE plies aren't kept, so they aren't counted
+/// @param game The game
+/// @return The number of earlier occurrences, or 0 if game is NULL
+size_t chess_repetitions(const chess_game_t* game);
+/// @brief Indicates whether any piece of a team attacks a square
+/// @param game The game
+/// @param index The board index of the square
+/// @param by_team The attacking team
+/// @return True if the square is attacked, otherwise false
+bool chess_is_attacked(const chess_game_t* game, chess_index_t index, chess_team_t by_team);
 #ifdef __cplusplus
 }
 #endif
@@ -138,7 +371,17 @@ bool chess_can_castle(const chess_game_t* game, chess_team_t team);
 // Retrieves the chess piece type from a chess id
 #define CHESS_TYPE(id) ((chess_type_t)(id & 7))
 // Crates a chess id from a chess team and piece type
-#define CHESS_ID(team, type) (((chess_value_t)(team) ? (1 << 3) : (0 << 3)) | (int)type)
+#define CHESS_ID(team, type) (((chess_value_t)(team) ? (1 << 3) : (0 << 3)) | (int)(type))
+// Retrieves the index a packed move starts from
+#define CHESS_MOVE_FROM(move) ((chess_index_t)((move) & 63))
+// Retrieves the index a packed move ends on
+#define CHESS_MOVE_TO(move) ((chess_index_t)(((move) >> 6) & 63))
+// Retrieves the chess_move_flags_t of a packed move
+#define CHESS_MOVE_FLAGS(move) ((chess_move_flags_t)(((move) >> 12) & 15))
+// Retrieves the type a packed move promotes to, or CHESS_NONE if it isn't a promotion
+#define CHESS_MOVE_PROMOTION(move) ((chess_value_t)(CHESS_MOVE_FLAGS(move) >= CHESS_MOVE_PROMOTE_BISHOP ? (int)CHESS_MOVE_FLAGS(move) - 3 : -1))
+// Creates a packed move from the from index, the to index and the chess_move_flags_t
+#define CHESS_MOVE(from, to, flags) ((chess_move_t)((from) | ((to) << 6) | ((int)(flags) << 12)))
 // alias for a non-value
 #define CHESS_NONE ((chess_value_t)-1)
 
@@ -0,0 +1,396 @@
+// C++17 interface for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_HPP
+#define CHESS_HPP
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chess.h"
+
+namespace htcw {
+namespace chess {
+/// @brief A set of board indices, one bit per index
+using bitboard_t = uint64_t;
+
+namespace helpers {
+constexpr bitboard_t bit(int index) { return bitboard_t(1) << index; }
+// the bit at rank/file, or 0 if that's off the board
+constexpr bitboard_t square_bit(int rank, int file) {
+    return (rank < 0 || rank > 7 || file < 0 || file > 7) ? 0 : bit(rank * 8 + file);
+}
+constexpr bitboard_t rank_1 = 0x00000000000000FFULL;
+constexpr bitboard_t rank_8 = 0xFF00000000000000ULL;
+// rank and file steps, in the same order as the library's: the rook directions, then the bishop directions.
+// The first two of each group step to higher indices
+constexpr int directions[8][2] = {
+    {1, 0}, {0, 1}, {-1, 0}, {0, -1},
+    {1, 1}, {1, -1}, {-1, -1}, {-1, 1}
+};
+constexpr bool is_positive(int direction) { return (direction & 2) == 0; }
+
+struct tables_t {
+    bitboard_t knight[64];
+    bitboard_t king[64];
+    bitboard_t pawn[2][64];
+    // everything from an index to the edge of the board in each direction
+    bitboard_t rays[8][64];
+};
+constexpr tables_t make_tables() {
+    tables_t result{};
+    for (int index = 0; index < 64; ++index) {
+        const int rank = index / 8;
+        const int file = index % 8;
+        result.knight[index] = square_bit(rank + 2, file - 1) | square_bit(rank + 2, file + 1) |
+                               square_bit(rank - 2, file - 1) | square_bit(rank - 2, file + 1) |
+                               square_bit(rank + 1, file - 2) | square_bit(rank + 1, file + 2) |
+                               square_bit(rank - 1, file - 2) | square_bit(rank - 1, file + 2);
+        for (int i = 0; i < 8; ++i) {
+            result.king[index] |= square_bit(rank + directions[i][0], file + directions[i][1]);
+            int ray_rank = rank + directions[i][0];
+            int ray_file = file + directions[i][1];
+            while (square_bit(ray_rank, ray_file)) {
+                result.rays[i][index] |= square_bit(ray_rank, ray_file);
+                ray_rank += directions[i][0];
+                ray_file += directions[i][1];
+            }
+        }
+        result.pawn[CHESS_WHITE][index] = square_bit(rank + 1, file - 1) | square_bit(rank + 1, file + 1);
+        result.pawn[CHESS_BLACK][index] = square_bit(rank - 1, file - 1) | square_bit(rank - 1, file + 1);
+    }
+    return result;
+}
+// built by the compiler, so there's nothing to initialize at run time
+inline constexpr tables_t tables = make_tables();
+
+inline int bit_first(bitboard_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    // de Bruijn sequence bit scan for compilers without a builtin
+    constexpr int table[64] = {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+        62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+        46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6};
+    return table[((bits & (~bits + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+#endif
+}
+inline int bit_last(bitboard_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(bits);
+#else
+    // smear the top bit down, then only it is left when shifted back
+    bits |= bits >> 1;
+    bits |= bits >> 2;
+    bits |= bits >> 4;
+    bits |= bits >> 8;
+    bits |= bits >> 16;
+    bits |= bits >> 32;
+    return bit_first(bits ^ (bits >> 1));
+#endif
+}
+inline int bit_pop(bitboard_t* bits) {
+    const int result = bit_first(*bits);
+    *bits &= *bits - 1;
+    return result;
+}
+
+// the squares along a direction up to and including the first occupied one
+template <int Direction>
+inline bitboard_t ray_attacks(int index, bitboard_t occupied) {
+    const bitboard_t ray = tables.rays[Direction][index];
+    const bitboard_t blockers = ray & occupied;
+    if (blockers == 0) {
+        return ray;
+    }
+    if constexpr (is_positive(Direction)) {
+        return ray ^ tables.rays[Direction][bit_first(blockers)];
+    } else {
+        return ray ^ tables.rays[Direction][bit_last(blockers)];
+    }
+}
+// the squares between two indices on the same rank, file or diagonal, otherwise 0
+inline bitboard_t squares_between(int index_a, int index_b) {
+    for (int i = 0; i < 8; ++i) {
+        if (tables.rays[i][index_a] & bit(index_b)) {
+            return tables.rays[i][index_a] & ~tables.rays[i][index_b] & ~bit(index_b);
+        }
+    }
+    return 0;
+}
+// the whole line through two indices on the same rank, file or diagonal, otherwise 0
+inline bitboard_t squares_in_line(int index_a, int index_b) {
+    for (int i = 0; i < 8; ++i) {
+        if (tables.rays[i][index_a] & bit(index_b)) {
+            return tables.rays[i][index_a] | tables.rays[(i + 2) % 4 + (i & 4)][index_a] | bit(index_a);
+        }
+    }
+    return 0;
+}
+constexpr chess_team_t opponent(chess_team_t team) { return team == CHESS_WHITE ? CHESS_BLACK : CHESS_WHITE; }
+// moves a set of pawns one rank forward for their team
+template <chess_team_t Team>
+constexpr bitboard_t forward(bitboard_t bits) {
+    if constexpr (Team == CHESS_WHITE) {
+        return bits << 8;
+    } else {
+        return bits >> 8;
+    }
+}
+inline void add_moves(chess_move_list_t& list, int index_from, bitboard_t to_mask, chess_move_flags_t flags) {
+    while (to_mask) {
+        list.moves[list.size++] = CHESS_MOVE(index_from, bit_pop(&to_mask), flags);
+    }
+}
+}  // namespace helpers
+
+/// @brief The squares a piece of a type attacks from an index, given the occupancy. Pawns are handled by pawn_attacks()
+/// @tparam Type The piece type
+/// @param index The index of the piece
+/// @param occupied The occupied squares, which block sliding pieces
+/// @return The attacked squares
+template <chess_type_t Type>
+inline bitboard_t attacks(int index, bitboard_t occupied) {
+    static_assert(Type != CHESS_PAWN, "use pawn_attacks()");
+    if constexpr (Type == CHESS_KNIGHT) {
+        return helpers::tables.knight[index];
+    } else if constexpr (Type == CHESS_KING) {
+        return helpers::tables.king[index];
+    } else if constexpr (Type == CHESS_BISHOP) {
+        return helpers::ray_attacks<4>(index, occupied) | helpers::ray_attacks<5>(index, occupied) |
+               helpers::ray_attacks<6>(index, occupied) | helpers::ray_attacks<7>(index, occupied);
+    } else if constexpr (Type == CHESS_ROOK) {
+        return helpers::ray_attacks<0>(index, occupied) | helpers::ray_attacks<1>(index, occupied) |
+               helpers::ray_attacks<2>(index, occupied) | helpers::ray_attacks<3>(index, occupied);
+    } else {
+        return attacks<CHESS_BISHOP>(index, occupied) | attacks<CHESS_ROOK>(index, occupied);
+    }
+}
+/// @brief The squares a pawn of a team attacks from an index
+/// @tparam Team The team of the pawn
+/// @param index The index of the pawn
+/// @return The attacked squares
+template <chess_team_t Team>
+inline bitboard_t pawn_attacks(int index) {
+    return helpers::tables.pawn[Team][index];
+}
+
+/// @brief A chess position with move generation and attack detection specialized at compile time for each team and piece type
+/// @remarks This wraps a chess_game_t, which can be passed to any of the C functions through game(). It generates the same moves as chess_generate_moves(), though not necessarily in the same order
+class position final {
+    chess_game_t m_game;
+
+    template <chess_team_t Us>
+    void generate_pawns(chess_move_list_t& out_moves, bitboard_t evasions, bitboard_t pinned) const {
+        constexpr chess_team_t them = helpers::opponent(Us);
+        constexpr bitboard_t last_rank = Us == CHESS_WHITE ? helpers::rank_8 : helpers::rank_1;
+        // a pawn that lands here after one step can take another
+        constexpr bitboard_t double_rank = Us == CHESS_WHITE ? 0x0000000000FF0000ULL : 0x0000FF0000000000ULL;
+        const bitboard_t enemies = m_game.teams[them];
+        const bitboard_t empty = ~(m_game.teams[Us] | enemies);
+        const int king_index = m_game.kings[Us];
+        bitboard_t pawns = m_game.pieces[CHESS_PAWN] & m_game.teams[Us];
+        while (pawns) {
+            const int index = helpers::bit_pop(&pawns);
+            const bitboard_t single = helpers::forward<Us>(helpers::bit(index)) & empty;
+            bitboard_t double_push = helpers::forward<Us>(single & double_rank) & empty & evasions;
+            bitboard_t moves = ((single | (pawn_attacks<Us>(index) & enemies)) & evasions) | double_push;
+            if (pinned & helpers::bit(index)) {
+                const bitboard_t line = helpers::squares_in_line(king_index, index);
+                moves &= line;
+                double_push &= line;
+            }
+            moves &= ~double_push;
+            bitboard_t promotions = moves & last_rank;
+            moves &= ~last_rank;
+            while (promotions) {
+                const int to_index = helpers::bit_pop(&promotions);
+                for (int i = CHESS_MOVE_PROMOTE_BISHOP; i <= CHESS_MOVE_PROMOTE_QUEEN; ++i) {
+                    out_moves.moves[out_moves.size++] = CHESS_MOVE(index, to_index, i);
+                }
+            }
+            helpers::add_moves(out_moves, index, moves, CHESS_MOVE_NORMAL);
+            helpers::add_moves(out_moves, index, double_push, CHESS_MOVE_DOUBLE_PUSH);
+            if (m_game.en_passant != CHESS_NONE && (pawn_attacks<Us>(index) & helpers::bit(m_game.en_passant))) {
+                // two pawns leave the line at once, so look again for anything that can reach the king
+                const int captured = Us == CHESS_WHITE ? m_game.en_passant - 8 : m_game.en_passant + 8;
+                const bitboard_t occupied = ((m_game.teams[Us] | enemies) ^ helpers::bit(index) ^ helpers::bit(captured)) | helpers::bit(m_game.en_passant);
+                if (king_index == CHESS_NONE || 0 == (attackers<them>(king_index, occupied) & ~helpers::bit(captured))) {
+                    out_moves.moves[out_moves.size++] = CHESS_MOVE(index, m_game.en_passant, CHESS_MOVE_EN_PASSANT);
+                }
+            }
+        }
+    }
+    template <chess_team_t Us, chess_type_t Type>
+    void generate_pieces(chess_move_list_t& out_moves, bitboard_t evasions, bitboard_t pinned) const {
+        const bitboard_t occupied = m_game.teams[CHESS_WHITE] | m_game.teams[CHESS_BLACK];
+        bitboard_t pieces = m_game.pieces[Type] & m_game.teams[Us];
+        while (pieces) {
+            const int index = helpers::bit_pop(&pieces);
+            bitboard_t moves = attacks<Type>(index, occupied) & ~m_game.teams[Us] & evasions;
+            if (pinned & helpers::bit(index)) {
+                moves &= helpers::squares_in_line(m_game.kings[Us], index);
+            }
+            helpers::add_moves(out_moves, index, moves, CHESS_MOVE_NORMAL);
+        }
+    }
+    template <chess_team_t Us>
+    void generate_king(chess_move_list_t& out_moves, bool checked) const {
+        constexpr chess_team_t them = helpers::opponent(Us);
+        // the squares involved in each castle: king side, then queen side
+        constexpr int castle_rights[2] = {Us == CHESS_WHITE ? CHESS_CASTLE_WHITE_KING_SIDE : CHESS_CASTLE_BLACK_KING_SIDE,
+                                          Us == CHESS_WHITE ? CHESS_CASTLE_WHITE_QUEEN_SIDE : CHESS_CASTLE_BLACK_QUEEN_SIDE};
+        constexpr int rank = Us == CHESS_WHITE ? 0 : 56;
+        constexpr bitboard_t empty[2] = {helpers::bit(rank + 5) | helpers::bit(rank + 6),
+                                         helpers::bit(rank + 1) | helpers::bit(rank + 2) | helpers::bit(rank + 3)};
+        constexpr int transit[2][2] = {{rank + 5, rank + 6}, {rank + 3, rank + 2}};
+        const int index = m_game.kings[Us];
+        const bitboard_t occupied = m_game.teams[CHESS_WHITE] | m_game.teams[CHESS_BLACK];
+        // take the king off the board so it can't shelter behind itself from a slider
+        const bitboard_t occupied_without_king = occupied & ~helpers::bit(index);
+        bitboard_t candidates = attacks<CHESS_KING>(index, occupied) & ~m_game.teams[Us];
+        while (candidates) {
+            const int to_index = helpers::bit_pop(&candidates);
+            if (0 == attackers<them>(to_index, occupied_without_king)) {
+                out_moves.moves[out_moves.size++] = CHESS_MOVE(index, to_index, CHESS_MOVE_NORMAL);
+            }
+        }
+        if (checked) {
+            return;
+        }
+        for (int i = 0; i < 2; ++i) {
+            // the right goes as soon as the king or rook moves or the rook is taken, so both are home
+            if ((m_game.castle_rights & castle_rights[i]) && 0 == (occupied & empty[i]) &&
+                !attacked<them>(transit[i][0]) && !attacked<them>(transit[i][1])) {
+                out_moves.moves[out_moves.size++] = CHESS_MOVE(index, transit[i][1], CHESS_MOVE_CASTLE);
+            }
+        }
+    }
+
+   public:
+    /// @brief Constructs a position set up for a new game
+    position() { chess_init(&m_game); }
+    /// @brief Constructs a position from a game
+    /// @param game The game to copy
+    explicit position(const chess_game_t& game) : m_game(game) {}
+    /// @brief Provides the underlying game, for use with the C functions
+    /// @return The game
+    const chess_game_t& game() const { return m_game; }
+    /// @brief Provides the underlying game, for use with the C functions
+    /// @return The game
+    chess_game_t& game() { return m_game; }
+    /// @brief Indicates which team is up
+    /// @return The team that is up
+    chess_team_t turn() const { return m_game.turn; }
+    /// @brief Sets up the position from FEN
+    /// @param fen The FEN string
+    /// @return CHESS_SUCCESS if the operation was successful, otherwise CHESS_INVALID and the position is untouched
+    chess_result_t fen(const char* fen) { return chess_from_fen(&m_game, fen); }
+    /// @brief Finds every piece of a team that attacks an index
+    /// @tparam By The team of the attackers
+    /// @param index The board index
+    /// @param occupied The occupied squares, which block sliding pieces
+    /// @return The attacking pieces
+    template <chess_team_t By>
+    bitboard_t attackers(int index, bitboard_t occupied) const {
+        const bitboard_t queens = m_game.pieces[CHESS_QUEEN];
+        return m_game.teams[By] & ((pawn_attacks<helpers::opponent(By)>(index) & m_game.pieces[CHESS_PAWN]) |
+                                   (attacks<CHESS_KNIGHT>(index, occupied) & m_game.pieces[CHESS_KNIGHT]) |
+                                   (attacks<CHESS_KING>(index, occupied) & m_game.pieces[CHESS_KING]) |
+                                   (attacks<CHESS_BISHOP>(index, occupied) & (m_game.pieces[CHESS_BISHOP] | queens)) |
+                                   (attacks<CHESS_ROOK>(index, occupied) & (m_game.pieces[CHESS_ROOK] | queens)));
+    }
+    /// @brief Indicates whether a team attacks an index
+    /// @tparam By The team of the attackers
+    /// @param index The board index
+    /// @return True if the index is attacked, otherwise false
+    template <chess_team_t By>
+    bool attacked(int index) const {
+        const bitboard_t pieces = m_game.teams[By];
+        // the cheap ones first
+        if ((pawn_attacks<helpers::opponent(By)>(index) & m_game.pieces[CHESS_PAWN] & pieces) ||
+            (attacks<CHESS_KNIGHT>(index, 0) & m_game.pieces[CHESS_KNIGHT] & pieces) ||
+            (attacks<CHESS_KING>(index, 0) & m_game.pieces[CHESS_KING] & pieces)) {
+            return true;
+        }
+        const bitboard_t occupied = m_game.teams[CHESS_WHITE] | m_game.teams[CHESS_BLACK];
+        const bitboard_t queens = m_game.pieces[CHESS_QUEEN];
+        return (attacks<CHESS_BISHOP>(index, occupied) & (m_game.pieces[CHESS_BISHOP] | queens) & pieces) ||
+               (attacks<CHESS_ROOK>(index, occupied) & (m_game.pieces[CHESS_ROOK] | queens) & pieces);
+    }
+    /// @brief Indicates whether a team attacks an index
+    /// @param index The board index
+    /// @param by The team of the attackers
+    /// @return True if the index is attacked, otherwise false
+    bool attacked(int index, chess_team_t by) const {
+        return by == CHESS_WHITE ? attacked<CHESS_WHITE>(index) : attacked<CHESS_BLACK>(index);
+    }
+    /// @brief Indicates whether the team that is up is in check
+    /// @return True if in check, otherwise false
+    bool in_check() const {
+        const int king_index = m_game.kings[m_game.turn];
+        return king_index != CHESS_NONE && attacked(king_index, helpers::opponent(m_game.turn));
+    }
+    /// @brief Generates every legal move for a team, which must be the team that is up
+    /// @tparam Us The team that is up
+    /// @param out_moves The list to fill
+    /// @return The number of moves generated
+    template <chess_team_t Us>
+    size_t generate(chess_move_list_t& out_moves) const {
+        constexpr chess_team_t them = helpers::opponent(Us);
+        out_moves.size = 0;
+        const int king_index = m_game.kings[Us];
+        if (king_index == CHESS_NONE) {
+            // nothing to keep safe
+            generate_pawns<Us>(out_moves, ~bitboard_t(0), 0);
+            generate_pieces<Us, CHESS_KNIGHT>(out_moves, ~bitboard_t(0), 0);
+            generate_pieces<Us, CHESS_BISHOP>(out_moves, ~bitboard_t(0), 0);
+            generate_pieces<Us, CHESS_ROOK>(out_moves, ~bitboard_t(0), 0);
+            generate_pieces<Us, CHESS_QUEEN>(out_moves, ~bitboard_t(0), 0);
+            return out_moves.size;
+        }
+        const bitboard_t enemies = m_game.teams[them];
+        const bitboard_t occupied = m_game.teams[Us] | enemies;
+        const bitboard_t checkers = attackers<them>(king_index, occupied);
+        generate_king<Us>(out_moves, checkers != 0);
+        if (checkers & (checkers - 1)) {
+            return out_moves.size;  // double check, only the king can move
+        }
+        const bitboard_t evasions = checkers ? helpers::squares_between(king_index, helpers::bit_first(checkers)) | checkers : ~bitboard_t(0);
+        // sliders that would reach the king if our pieces weren't in the way
+        const bitboard_t queens = m_game.pieces[CHESS_QUEEN];
+        bitboard_t snipers = enemies & ((attacks<CHESS_ROOK>(king_index, enemies) & (m_game.pieces[CHESS_ROOK] | queens)) |
+                                        (attacks<CHESS_BISHOP>(king_index, enemies) & (m_game.pieces[CHESS_BISHOP] | queens)));
+        bitboard_t pinned = 0;
+        while (snipers) {
+            const bitboard_t blockers = helpers::squares_between(king_index, helpers::bit_pop(&snipers)) & occupied;
+            if (blockers && 0 == (blockers & (blockers - 1)) && (blockers & m_game.teams[Us])) {
+                pinned |= blockers;
+            }
+        }
+        generate_pawns<Us>(out_moves, evasions, pinned);
+        generate_pieces<Us, CHESS_KNIGHT>(out_moves, evasions, pinned);
+        generate_pieces<Us, CHESS_BISHOP>(out_moves, evasions, pinned);
+        generate_pieces<Us, CHESS_ROOK>(out_moves, evasions, pinned);
+        generate_pieces<Us, CHESS_QUEEN>(out_moves, evasions, pinned);
+        return out_moves.size;
+    }
+    /// @brief Generates every legal move for the team that is up
+    /// @param out_moves The list to fill
+    /// @return The number of moves generated
+    size_t generate(chess_move_list_t& out_moves) const {
+        return m_game.turn == CHESS_WHITE ? generate<CHESS_WHITE>(out_moves) : generate<CHESS_BLACK>(out_moves);
+    }
+    /// @brief Plays a generated move. See chess_make_move()
+    /// @param move The move
+    /// @param out_undo The state to take the move back with, or nullptr
+    /// @return The index of the capture victim or CHESS_NONE
+    chess_index_t make(chess_move_t move, chess_undo_t* out_undo = nullptr) { return chess_make_move(&m_game, move, out_undo); }
+    /// @brief Takes back a move made with make()
+    /// @param undo The state from make()
+    void unmake(const chess_undo_t& undo) { chess_unmake_move(&m_game, &undo); }
+};
+}  // namespace chess
+}  // namespace htcw
+#endif  // CHESS_HPP
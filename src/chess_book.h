@@ -0,0 +1,73 @@
+// Polyglot opening books for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_BOOK_H
+#define CHESS_BOOK_H
+#include "chess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The number of entries in the Polyglot Random64 table
+#define CHESS_BOOK_RANDOM_COUNT 781
+
+/// @brief A Polyglot opening book (effectively private)
+typedef struct {
+    /// @brief The book's 16 byte entries, sorted by key
+    const uint8_t* data;
+    /// @brief The number of entries
+    size_t count;
+    /// @brief The Polyglot Random64 table
+    const uint64_t* random64;
+    /// @brief The file mapping, if the book was opened from a file
+    void* mapping;
+    /// @brief The size of the mapping
+    size_t mapping_size;
+} chess_book_t;
+
+/// @brief A move from the book
+typedef struct {
+    /// @brief The move, as generated by chess_generate_moves()
+    chess_move_t move;
+    /// @brief How often the move should be played, relative to the others for the position
+    uint16_t weight;
+    /// @brief The book's learning data
+    uint32_t learn;
+} chess_book_entry_t;
+
+/// @brief Opens a Polyglot .bin book by mapping it into memory
+/// @remarks Nothing is read or parsed up front, and the pages are shared with every other process that maps the same book. Only available on Windows and POSIX targets. Elsewhere, use chess_book_open_memory()
+/// @param out_book The book to open
+/// @param path The path of the book
+/// @param random64 The CHESS_BOOK_RANDOM_COUNT entry Random64 table from the Polyglot book format specification, which must stay valid while the book is open
+/// @return CHESS_SUCCESS if the book was opened, otherwise CHESS_INVALID if invalid argument, random64 isn't the standard table, or the file couldn't be mapped
+chess_result_t chess_book_open(chess_book_t* out_book, const char* path, const uint64_t* random64);
+/// @brief Opens a Polyglot book that's already in memory, such as one stored in flash
+/// @param out_book The book to open
+/// @param data The book's contents, which must stay valid while the book is open
+/// @param size The size of data, in bytes
+/// @param random64 The CHESS_BOOK_RANDOM_COUNT entry Random64 table from the Polyglot book format specification, which must stay valid while the book is open
+/// @return CHESS_SUCCESS if the book was opened, otherwise CHESS_INVALID if invalid argument or random64 isn't the standard table
+chess_result_t chess_book_open_memory(chess_book_t* out_book, const void* data, size_t size, const uint64_t* random64);
+/// @brief Closes a book, unmapping it if it was opened from a file
+/// @param book The book
+void chess_book_close(chess_book_t* book);
+/// @brief Computes the Polyglot key of a position
+/// @param book The book, for its Random64 table
+/// @param game The game
+/// @return The key, or 0 if invalid argument
+uint64_t chess_book_key(const chess_book_t* book, const chess_game_t* game);
+/// @brief Finds the book moves for a position
+/// @remarks The entries are found by binary search on the position's Polyglot key, and are read straight from the book. Only moves that are legal in the position are returned, so a key collision can't produce a bad move
+/// @param book The book
+/// @param game The game
+/// @param out_entries The entries to fill, in book order, or NULL to just count them
+/// @param max_entries The size of out_entries
+/// @return The number of book moves for the position, which may be more than max_entries
+size_t chess_book_probe(const chess_book_t* book, const chess_game_t* game, chess_book_entry_t* out_entries, size_t max_entries);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHESS_BOOK_H
@@ -0,0 +1,31 @@
+// Parallel move tree walks for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_PERFT_H
+#define CHESS_PERFT_H
+#include "chess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Counts the positions at the leaves of the move tree
+/// @remarks The tree is split into subtrees a few plies down, which a pool of threads works through, stealing from each other as they run dry. Each thread's run of subtrees is taken from with a compare and swap rather than a lock, and a subtree keeps only the moves that lead to it, so there's little to copy. On targets without threads, or if memory is short, it walks the tree on the calling thread
+/// @param game The game to start from
+/// @param depth The number of plies to walk
+/// @param threads The number of threads to use, or 0 for one per hardware thread
+/// @return The number of leaf positions, or 0 on invalid arguments
+unsigned long long chess_perft(const chess_game_t* game, int depth, int threads);
+/// @brief Counts the positions at the leaves of the move tree under each legal move
+/// @param game The game to start from
+/// @param depth The number of plies to walk, counting the first move
+/// @param threads The number of threads to use, or 0 for one per hardware thread
+/// @param out_moves The list to fill with the legal moves, as from chess_generate_moves()
+/// @param out_counts The counts for each move in out_moves. Should hold CHESS_MAX_MOVES entries
+/// @return The total number of leaf positions, or 0 on invalid arguments
+unsigned long long chess_perft_divide(const chess_game_t* game, int depth, int threads, chess_move_list_t* out_moves, unsigned long long* out_counts);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHESS_PERFT_H
@@ -0,0 +1,84 @@
+// Streaming PGN validation for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_PGN_H
+#define CHESS_PGN_H
+#include "chess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The largest game, tags and movetext, that can be validated
+#define CHESS_PGN_MAX_GAME (64 * 1024)
+
+/// @brief The outcome of validating a game
+typedef enum {
+    /// @brief Every move in the game is legal
+    CHESS_PGN_VALID = 0,
+    /// @brief A move is illegal or ambiguous in its position
+    CHESS_PGN_ILLEGAL_MOVE = 1,
+    /// @brief The game text couldn't be parsed
+    CHESS_PGN_BAD_SYNTAX = 2,
+    /// @brief The FEN tag holds an invalid position
+    CHESS_PGN_BAD_FEN = 3,
+    /// @brief The game is longer than CHESS_PGN_MAX_GAME
+    CHESS_PGN_TOO_LONG = 4
+} chess_pgn_verdict_t;
+
+/// @brief The result for one game
+typedef struct {
+    /// @brief The index of the game in the input, starting at 0
+    size_t index;
+    /// @brief The outcome
+    chess_pgn_verdict_t verdict;
+    /// @brief The number of moves that were legal. For an illegal game, this is the index of the first bad move
+    unsigned int plies;
+    /// @brief The offset of the game's first character in the input
+    unsigned long long offset;
+} chess_pgn_game_result_t;
+
+/// @brief Totals for a whole input
+typedef struct {
+    /// @brief The number of games read
+    size_t games;
+    /// @brief The number of games that were valid
+    size_t valid;
+    /// @brief The number of legal moves replayed across all games
+    unsigned long long plies;
+    /// @brief The number of bytes read
+    unsigned long long bytes;
+} chess_pgn_stats_t;
+
+/// @brief Reads the next chunk of input
+/// @param buffer The buffer to fill
+/// @param size The size of the buffer
+/// @param state The state passed to chess_pgn_validate()
+/// @return The number of bytes read, or 0 at the end of the input
+typedef size_t (*chess_pgn_read_t)(char* buffer, size_t size, void* state);
+/// @brief Receives the result for a game. Called on the thread that called chess_pgn_validate(), in input order
+/// @param result The result
+/// @param state The state passed to chess_pgn_validate()
+typedef void (*chess_pgn_callback_t)(const chess_pgn_game_result_t* result, void* state);
+
+/// @brief Validates every game in a PGN stream, spreading the games over several threads
+/// @remarks Games are separated by their tag sections, as in export format PGN. The input is read in chunks, so it can be any size
+/// @param read The function to read the input with
+/// @param read_state The state to pass to read
+/// @param threads The number of worker threads, or 0 for one per hardware thread. On targets without threads the games are validated on the calling thread
+/// @param callback The function to receive each game's result, or NULL
+/// @param callback_state The state to pass to callback
+/// @param out_stats The totals for the input, or NULL
+/// @return CHESS_SUCCESS if the input was read to the end, CHESS_OUT_OF_MEMORY if the buffers couldn't be allocated, otherwise CHESS_INVALID
+chess_result_t chess_pgn_validate(chess_pgn_read_t read, void* read_state, int threads, chess_pgn_callback_t callback, void* callback_state, chess_pgn_stats_t* out_stats);
+/// @brief Validates a single game
+/// @param text The game's tags and movetext
+/// @param size The length of text
+/// @param out_result The result to fill. Its index and offset are set to 0
+/// @return CHESS_SUCCESS if the game was checked, otherwise CHESS_INVALID on invalid arguments
+chess_result_t chess_pgn_validate_game(const char* text, size_t size, chess_pgn_game_result_t* out_result);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHESS_PGN_H
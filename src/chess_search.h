@@ -0,0 +1,53 @@
+// Move search for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_SEARCH_H
+#define CHESS_SEARCH_H
+#include "chess.h"
+#include "chess_tt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The score of a checkmate on the board. A mate in n plies scores CHESS_SEARCH_MATE - n
+#define CHESS_SEARCH_MATE 32000
+/// @brief The deepest a search goes, in plies
+#define CHESS_SEARCH_MAX_DEPTH 64
+
+/// @brief When to stop searching. A limit of 0 is no limit, but at least one must be set
+typedef struct {
+    /// @brief The deepest to search, in plies
+    int depth;
+    /// @brief The most positions to visit
+    unsigned long long nodes;
+    /// @brief The longest to search, in milliseconds
+    unsigned int milliseconds;
+    /// @brief A transposition table to keep results in between searches, or NULL to search without one
+    chess_tt_t* tt;
+} chess_search_limits_t;
+
+/// @brief The outcome of a search
+typedef struct {
+    /// @brief The best move found
+    chess_move_t move;
+    /// @brief The score of the move for the team that is up, in hundredths of a pawn. See CHESS_SEARCH_MATE
+    int score;
+    /// @brief The depth of the deepest search that finished
+    int depth;
+    /// @brief The number of positions visited
+    unsigned long long nodes;
+} chess_search_result_t;
+
+/// @brief Finds the best move for the team that is up
+/// @remarks This is an alpha-beta search that deepens one ply at a time until a limit is reached, and reports the best move from the deepest search that finished. Positions are scored by chess_evaluate(), and captures are ordered by the values from chess_type_score(). The first ply is always searched in full, so there is a move even if the limits are very tight
+/// @param game The game
+/// @param limits When to stop searching
+/// @param out_best The result
+/// @return CHESS_SUCCESS if a move was found, otherwise CHESS_INVALID if invalid argument, no limit is set, or the team that is up has no legal moves
+chess_result_t chess_search(const chess_game_t* game, const chess_search_limits_t* limits, chess_search_result_t* out_best);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHESS_SEARCH_H
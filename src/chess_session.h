@@ -0,0 +1,105 @@
+// Pooled multi-game sessions for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_SESSION_H
+#define CHESS_SESSION_H
+#include "chess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief The most games a session can hold
+#define CHESS_SESSION_MAX_GAMES (1 << 24)
+/// @brief A handle that never refers to a game
+#define CHESS_SESSION_NO_HANDLE 0
+
+/// @brief Refers to a game in a session. A handle stops working when its game is closed, even though the slot behind it is handed out again under a new handle. The slot index is in the low 24 bits and a 32-bit count of the slot's reopens is above it, so an old handle won't come back into use for over four billion reopens of its slot
+typedef uint64_t chess_session_handle_t;
+
+/// @brief A set of games worked on by a pool of threads (opaque)
+typedef struct chess_session chess_session_t;
+
+/// @brief The outcome of a submitted move
+typedef struct {
+    /// @brief The game the move was for
+    chess_session_handle_t handle;
+    /// @brief The index moved from
+    chess_index_t from;
+    /// @brief The index moved to
+    chess_index_t to;
+    /// @brief What chess_move() returned: the index of the capture victim, CHESS_NONE if no capture, or -2 if the move was illegal or the game has been closed
+    chess_index_t capture;
+    /// @brief What chess_status() returned after the move
+    bool playing;
+    /// @brief The white status after the move
+    chess_status_t white_status;
+    /// @brief The black status after the move
+    chess_status_t black_status;
+    /// @brief The game after the move, or NULL if the game has been closed. Only valid for the duration of the callback
+    const chess_game_t* game;
+} chess_session_result_t;
+
+/// @brief Receives the outcome of a move. Called on the thread that owns the game's shard, one move at a time per shard, in the order the moves were submitted for each game
+/// @param result The result
+/// @param state The state passed to chess_session_create()
+typedef void (*chess_session_callback_t)(const chess_session_result_t* result, void* state);
+
+/// @brief How to set up a session
+typedef struct {
+    /// @brief The most games open at once
+    size_t games;
+    /// @brief The number of shards, each with its own thread, or 0 for one per hardware thread
+    int threads;
+    /// @brief The most moves that can wait on each shard, rounded up to a power of two, or 0 for 1024
+    size_t queue_size;
+    /// @brief The function to receive each move's outcome, or NULL
+    chess_session_callback_t callback;
+    /// @brief The state to pass to callback
+    void* callback_state;
+} chess_session_config_t;
+
+/// @brief Creates a session
+/// @remarks Every game slot is allocated up front, in one cache line aligned block, so opening and closing games never touches the allocator. Games are split between the shards by handle, and each shard's games are only ever touched by its own thread. On targets without threads the moves are played on the thread that submits them
+/// @param config How to set up the session
+/// @param out_session The new session
+/// @return CHESS_SUCCESS if the session was created, CHESS_OUT_OF_MEMORY if it couldn't be allocated, otherwise CHESS_INVALID
+chess_result_t chess_session_create(const chess_session_config_t* config, chess_session_t** out_session);
+/// @brief Stops the session's threads and frees it. Moves already submitted are played first
+/// @param session The session
+void chess_session_destroy(chess_session_t* session);
+/// @brief Opens a game in the session
+/// @param session The session
+/// @param game The game to start from, or NULL for a new game
+/// @param out_handle The handle of the game
+/// @return CHESS_SUCCESS if the game was opened, CHESS_OUT_OF_MEMORY if the session is full, otherwise CHESS_INVALID
+chess_result_t chess_session_open(chess_session_t* session, const chess_game_t* game, chess_session_handle_t* out_handle);
+/// @brief Closes a game, once the moves already submitted for it are played
+/// @param session The session
+/// @param handle The game's handle
+/// @return CHESS_SUCCESS if the close was queued, CHESS_BUSY if the shard's queue is full, otherwise CHESS_INVALID
+chess_result_t chess_session_close(chess_session_t* session, chess_session_handle_t handle);
+/// @brief Queues a move for a game, to be played with chess_move() and checked with chess_status() on the game's shard
+/// @remarks This doesn't lock, so any number of threads can submit at once. The outcome goes to the session's callback
+/// @param session The session
+/// @param handle The game's handle
+/// @param index_from The index to move from
+/// @param index_to The index to move to
+/// @param promotion What a pawn reaching the end of the board promotes to. Anything that isn't a valid promotion means a queen
+/// @return CHESS_SUCCESS if the move was queued, CHESS_BUSY if the shard's queue is full, otherwise CHESS_INVALID
+chess_result_t chess_session_move(chess_session_t* session, chess_session_handle_t handle, chess_index_t index_from, chess_index_t index_to, chess_type_t promotion);
+/// @brief Waits until every move submitted so far has been played
+/// @param session The session
+void chess_session_flush(chess_session_t* session);
+/// @brief Copies a game out of the session
+/// @remarks The game's shard may be working on it, so only call this when no moves are waiting for the game, such as after chess_session_flush(). From the callback, use the game in the result instead
+/// @param session The session
+/// @param handle The game's handle
+/// @param out_game The copy
+/// @return CHESS_SUCCESS if the game was copied, otherwise CHESS_INVALID if invalid argument or the game has been closed
+chess_result_t chess_session_game(const chess_session_t* session, chess_session_handle_t handle, chess_game_t* out_game);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHESS_SESSION_H
@@ -0,0 +1,86 @@
+// A lockless transposition table for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_TT_H
+#define CHESS_TT_H
+#include "chess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief How a stored value relates to the real value of the position
+typedef enum {
+    /// @brief The value is exact, such as a move count or a status
+    CHESS_TT_EXACT = 0,
+    /// @brief The real value is at least the stored value
+    CHESS_TT_LOWER = 1,
+    /// @brief The real value is at most the stored value
+    CHESS_TT_UPPER = 2
+} chess_tt_bound_t;
+
+/// @brief The result stored for a position
+typedef struct {
+    /// @brief The value, such as a score, a count or a chess_status_t
+    int32_t value;
+    /// @brief The best move found, or 0 if none
+    chess_move_t move;
+    /// @brief The depth the value was computed to. Deeper results replace shallower ones
+    uint8_t depth;
+    /// @brief How the value relates to the real value
+    chess_tt_bound_t bound;
+} chess_tt_entry_t;
+
+/// @brief A slot in the table (effectively private)
+typedef struct {
+    /// @brief The key XOR the data, so that a torn write never verifies
+    uint64_t check;
+    /// @brief The packed entry
+    uint64_t data;
+} chess_tt_slot_t;
+
+/// @brief A transposition table that threads can share without a lock (effectively private)
+typedef struct {
+    /// @brief The slots
+    chess_tt_slot_t* slots;
+    /// @brief The slot count minus one. The slot count is a power of two
+    size_t mask;
+    /// @brief The current age. Entries from older searches are replaced first
+    uint8_t age;
+} chess_tt_t;
+
+/// @brief Initializes a transposition table over a caller supplied buffer, and clears it
+/// @remarks Each slot takes 16 bytes. The slot count is rounded down to a power of two, so any extra memory goes unused
+/// @param out_tt The table to initialize
+/// @param buffer The memory for the slots, aligned to 8 bytes
+/// @param size The size of the buffer in bytes. Must hold at least two slots
+/// @return CHESS_SUCCESS if successful, otherwise CHESS_INVALID
+chess_result_t chess_tt_init(chess_tt_t* out_tt, void* buffer, size_t size);
+/// @brief Removes all entries from the table
+/// @remarks Not safe to call while other threads are using the table
+/// @param tt The table
+void chess_tt_clear(chess_tt_t* tt);
+/// @brief Starts a new age, so that entries stored from now on are kept over older ones
+/// @remarks Not safe to call while other threads are using the table
+/// @param tt The table
+void chess_tt_new_search(chess_tt_t* tt);
+/// @brief Hints the CPU to start loading the slots for a key ahead of chess_tt_probe()
+/// @param tt The table
+/// @param key The key, such as from chess_hash()
+void chess_tt_prefetch(const chess_tt_t* tt, uint64_t key);
+/// @brief Looks up the entry for a key
+/// @param tt The table
+/// @param key The key, such as from chess_hash()
+/// @param out_entry The entry to fill if found
+/// @return True if an entry was found, otherwise false
+bool chess_tt_probe(const chess_tt_t* tt, uint64_t key, chess_tt_entry_t* out_entry);
+/// @brief Stores an entry for a key, replacing an older or shallower entry if necessary
+/// @param tt The table
+/// @param key The key, such as from chess_hash()
+/// @param entry The entry to store
+void chess_tt_store(chess_tt_t* tt, uint64_t key, const chess_tt_entry_t* entry);
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHESS_TT_H
@@ -5,7 +5,20 @@
 #ifndef NULL
 #define NULL 0
 #endif
-static chess_value_t scoring[] = {
+#if CHESS_HISTORY_SIZE < 0 || CHESS_HISTORY_SIZE > 128 || (CHESS_HISTORY_SIZE & (CHESS_HISTORY_SIZE - 1))
+#error CHESS_HISTORY_SIZE must be 0 or a power of two no larger than 128
+#endif
+// Sliding piece attacks are looked up in magic bitboard tables (about 860KB)
+// on 64-bit hosts. Smaller targets scan precomputed rays instead, which takes
+// 4KB. Define CHESS_MAGIC_BITBOARDS as 0 or 1 to override the choice.
+#ifndef CHESS_MAGIC_BITBOARDS
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#define CHESS_MAGIC_BITBOARDS 1
+#else
+#define CHESS_MAGIC_BITBOARDS 0
+#endif
+#endif
+static const chess_score_t scoring[] = {
     1,
     3,
     5,
@@ -14,429 +27,637 @@ static chess_value_t scoring[] = {
     200
 };
 
-static void move_until_obstacle(chess_value_t (*index_fn)(chess_value_t team, chess_value_t index), chess_value_t team, chess_value_t index, const chess_value_t* game_board, chess_value_t* out_moves, chess_value_t* out_size) {
-    chess_value_t i = index;
-    while (1) {
-        i = index_fn(team, i);
-        if (i != CHESS_NONE) {
-            if (game_board[i] != CHESS_NONE) {
-                if (CHESS_TEAM(game_board[i]) == team) {
-                    return;
-                }
-                out_moves[(*out_size)++] = i;
-                return;
-            } else {
-                out_moves[(*out_size)++] = i;
-            }
-        } else {
-            break;
-        }
-    }
+#define BIT(index) (((uint64_t)1) << (index))
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BIT_FIRST(bits) ((chess_value_t)__builtin_ctzll(bits))
+#else
+// de Bruijn sequence bit scan for compilers without a builtin
+static const chess_value_t bit_first_table[64] = {
+    0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+    62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+    63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+    46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+};
+#define BIT_FIRST(bits) (bit_first_table[(((bits) & (~(bits) + 1)) * 0x03f79d71b4cb0a89ULL) >> 58])
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BIT_COUNT(bits) ((size_t)__builtin_popcountll(bits))
+#else
+static size_t bit_count(uint64_t bits) {
+    bits = bits - ((bits >> 1) & 0x5555555555555555ULL);
+    bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (size_t)((bits * 0x0101010101010101ULL) >> 56);
 }
+#define BIT_COUNT(bits) bit_count(bits)
+#endif
 
-// With canonical indexing:
-// White is at bottom (indices 0-15), moves "up" the board (increasing indices, +8)
-// Black is at top (indices 48-63), moves "down" the board (decreasing indices, -8)
-static chess_value_t index_advance(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    if (team == CHESS_WHITE) {  // white moves up (increasing rank)
-        index += 8;
-    } else if (team == CHESS_BLACK) {  // black moves down (decreasing rank)
-        index -= 8;
-    }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
+// removes the lowest set bit from bits and returns its index
+static chess_value_t bit_pop(uint64_t* bits) {
+    const chess_value_t result = BIT_FIRST(*bits);
+    *bits &= *bits - 1;
+    return result;
 }
 
-static chess_value_t index_advance_left(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    const chess_value_t x = index % 8;
-    if (team == CHESS_WHITE) {  // white advances up-left
-        if (x == 0 || index + 7 > 63) {
-            return CHESS_NONE;
+// Zobrist keys. These are filled in once by init_tables() from a fixed seed,
+// so a position hashes the same way in every run
+static uint64_t zobrist_pieces[2][6][64];
+static uint64_t zobrist_en_passant[8];  // by the file of the en passant square
+static uint64_t zobrist_castle[4];  // one per castle right, toggled as each is lost
+static uint64_t zobrist_black;  // black to move
+
+#define ZOBRIST_PIECE(id, index) (zobrist_pieces[CHESS_TEAM(id)][CHESS_TYPE(id)][index])
+
+// the worth of each piece type in the middlegame and the endgame, in hundredths of a pawn
+static const int16_t material[2][6] = {
+    {82, 365, 477, 337, 1025, 0},
+    {94, 297, 512, 281, 936, 0}
+};
+// what each piece type adds to the game phase
+static const uint8_t phase_weights[6] = {0, 1, 2, 1, 4, 0};
+#define PHASE_MAX 24
+// bonuses for where a piece stands, in the middlegame and the endgame. These are
+// laid out as white sees the board, rank 8 first, so a white piece's index is flipped
+static const int16_t piece_squares[2][6][64] = {
+    {
+        // pawn
+        {
+              0,   0,   0,   0,   0,   0,   0,   0,
+             98, 134,  61,  95,  68, 126,  34, -11,
+             -6,   7,  26,  31,  65,  56,  25, -20,
+            -14,  13,   6,  21,  23,  12,  17, -23,
+            -27,  -2,  -5,  12,  17,   6,  10, -25,
+            -26,  -4,  -4, -10,   3,   3,  33, -12,
+            -35,  -1, -20, -23, -15,  24,  38, -22,
+              0,   0,   0,   0,   0,   0,   0,   0
+        },
+        // bishop
+        {
+            -29,   4, -82, -37, -25, -42,   7,  -8,
+            -26,  16, -18, -13,  30,  59,  18, -47,
+            -16,  37,  43,  40,  35,  50,  37,  -2,
+             -4,   5,  19,  50,  37,  37,   7,  -2,
+             -6,  13,  13,  26,  34,  12,  10,   4,
+              0,  15,  15,  15,  14,  27,  18,  10,
+              4,  15,  16,   0,   7,  21,  33,   1,
+            -33,  -3, -14, -21, -13, -12, -39, -21
+        },
+        // rook
+        {
+             32,  42,  32,  51,  63,   9,  31,  43,
+             27,  32,  58,  62,  80,  67,  26,  44,
+             -5,  19,  26,  36,  17,  45,  61,  16,
+            -24, -11,   7,  26,  24,  35,  -8, -20,
+            -36, -26, -12,  -1,   9,  -7,   6, -23,
+            -45, -25, -16, -17,   3,   0,  -5, -33,
+            -44, -16, -20,  -9,  -1,  11,  -6, -71,
+            -19, -13,   1,  17,  16,   7, -37, -26
+        },
+        // knight
+        {
+           -167, -89, -34, -49,  61, -97, -15,-107,
+            -73, -41,  72,  36,  23,  62,   7, -17,
+            -47,  60,  37,  65,  84, 129,  73,  44,
+             -9,  17,  19,  53,  37,  69,  18,  22,
+            -13,   4,  16,  13,  28,  19,  21,  -8,
+            -23,  -9,  12,  10,  19,  17,  25, -16,
+            -29, -53, -12,  -3,  -1,  18, -14, -19,
+           -105, -21, -58, -33, -17, -28, -19, -23
+        },
+        // queen
+        {
+            -28,   0,  29,  12,  59,  44,  43,  45,
+            -24, -39,  -5,   1, -16,  57,  28,  54,
+            -13, -17,   7,   8,  29,  56,  47,  57,
+            -27, -27, -16, -16,  -1,  17,  -2,   1,
+             -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+            -14,   2, -11,  -2,  -5,   2,  14,   5,
+            -35,  -8,  11,   2,   8,  15,  -3,   1,
+             -1, -18,  -9,  10, -15, -25, -31, -50
+        },
+        // king
+        {
+            -65,  23,  16, -15, -56, -34,   2,  13,
+             29,  -1, -20,  -7,  -8,  -4, -38, -29,
+             -9,  24,   2, -16, -20,   6,  22, -22,
+            -17, -20, -12, -27, -30, -25, -14, -36,
+            -49,  -1, -27, -39, -46, -44, -33, -51,
+            -14, -14, -22, -46, -44, -30, -15, -27,
+              1,   7,  -8, -64, -43, -16,   9,   8,
+            -15,  36,  12, -54,   8, -28,  24,  14
         }
-        index += 7;
-    } else if (team == CHESS_BLACK) {  // black advances down-left (from black's view)
-        if (x == 0 || index - 9 < 0) {
-            return CHESS_NONE;
+    },
+    {
+        // pawn
+        {
+              0,   0,   0,   0,   0,   0,   0,   0,
+            178, 173, 158, 134, 147, 132, 165, 187,
+             94, 100,  85,  67,  56,  53,  82,  84,
+             32,  24,  13,   5,  -2,   4,  17,  17,
+             13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+              4,   7,  -6,   1,   0,  -5,  -1,  -8,
+             13,   8,   8,  10,  13,   0,   2,  -7,
+              0,   0,   0,   0,   0,   0,   0,   0
+        },
+        // bishop
+        {
+            -14, -21, -11,  -8,  -7,  -9, -17, -24,
+             -8,  -4,   7, -12,  -3, -13,  -4, -14,
+              2,  -8,   0,  -1,  -2,   6,   0,   4,
+             -3,   9,  12,   9,  14,  10,   3,   2,
+             -6,   3,  13,  19,   7,  10,  -3,  -9,
+            -12,  -3,   8,  10,  13,   3,  -7, -15,
+            -14, -18,  -7,  -1,   4,  -9, -15, -27,
+            -23,  -9, -23,  -5,  -9, -16,  -5, -17
+        },
+        // rook
+        {
+             13,  10,  18,  15,  12,  12,   8,   5,
+             11,  13,  13,  11,  -3,   3,   8,   3,
+              7,   7,   7,   5,   4,  -3,  -5,  -3,
+              4,   3,  13,   1,   2,   1,  -1,   2,
+              3,   5,   8,   4,  -5,  -6,  -8, -11,
+             -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+             -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+             -9,   2,   3,  -1,  -5, -13,   4, -20
+        },
+        // knight
+        {
+            -58, -38, -13, -28, -31, -27, -63, -99,
+            -25,  -8, -25,  -2,  -9, -25, -24, -52,
+            -24, -20,  10,   9,  -1,  -9, -19, -41,
+            -17,   3,  22,  22,  22,  11,   8, -18,
+            -18,  -6,  16,  25,  16,  17,   4, -18,
+            -23,  -3,  -1,  15,  10,  -3, -20, -22,
+            -42, -20, -10,  -5,  -2, -20, -23, -44,
+            -29, -51, -23, -15, -22, -18, -50, -64
+        },
+        // queen
+        {
+             -9,  22,  22,  27,  27,  19,  10,  20,
+            -17,  20,  32,  41,  58,  25,  30,   0,
+            -20,   6,   9,  49,  47,  35,  19,   9,
+              3,  22,  24,  45,  57,  40,  57,  36,
+            -18,  28,  19,  47,  31,  34,  39,  23,
+            -16, -27,  15,   6,   9,  17,  10,   5,
+            -22, -23, -30, -16, -16, -23, -36, -32,
+            -33, -28, -22, -43,  -5, -32, -20, -41
+        },
+        // king
+        {
+            -74, -35, -18, -18, -11,  15,   4, -17,
+            -12,  17,  14,  17,  17,  38,  23,  11,
+             10,  17,  23,  15,  20,  45,  44,  13,
+             -8,  22,  24,  27,  26,  33,  26,   3,
+            -18,  -4,  21,  24,  27,  23,   9, -11,
+            -19,  -3,  11,  21,  23,  16,   7,  -9,
+            -27, -11,   4,  13,  14,   4,  -5, -17,
+            -53, -34, -21, -11, -28, -14, -24, -43
         }
-        index -= 9;
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
+};
+
+// what a piece adds to the evaluation in the given phase, from white's side
+static int piece_value(chess_value_t id, chess_value_t index, int phase) {
+    const chess_value_t type = CHESS_TYPE(id);
+    if (CHESS_TEAM(id) == CHESS_WHITE) {
+        return material[phase][type] + piece_squares[phase][type][index ^ 56];
+    }
+    return -(material[phase][type] + piece_squares[phase][type][index]);
 }
 
-static chess_value_t index_advance_right(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    const chess_value_t x = index % 8;
-    if (team == CHESS_WHITE) {  // white advances up-right
-        if (x == 7 || index + 9 > 63) {
-            return CHESS_NONE;
-        }
-        index += 9;
-    } else if (team == CHESS_BLACK) {  // black advances down-right (from black's view)
-        if (x == 7 || index - 7 < 0) {
-            return CHESS_NONE;
-        }
-        index -= 7;
+#if CHESS_EVALUATION
+// adds a piece to the running evaluation, or takes it away if sign is -1
+static void update_evaluation(chess_game_t* game, chess_value_t index, chess_value_t id, int sign) {
+    game->evaluation[0] = (int16_t)(game->evaluation[0] + sign * piece_value(id, index, 0));
+    game->evaluation[1] = (int16_t)(game->evaluation[1] + sign * piece_value(id, index, 1));
+    game->phase = (uint8_t)(game->phase + sign * phase_weights[CHESS_TYPE(id)]);
+}
+#endif
+
+// the board, the bitboards, the hash and the evaluation must always agree, so all writes go through here.
+// chess_unpack() is the one exception, and builds them all at once
+static void clear_square(chess_game_t* game, chess_value_t index) {
+    const chess_value_t id = game->board[index];
+    if (id != CHESS_NONE) {
+        const uint64_t mask = ~BIT(index);
+        game->pieces[CHESS_TYPE(id)] &= mask;
+        game->teams[CHESS_TEAM(id)] &= mask;
+        game->hash ^= ZOBRIST_PIECE(id, index);
+        game->board[index] = CHESS_NONE;
+#if CHESS_EVALUATION
+        update_evaluation(game, index, id, -1);
+#endif
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
 }
 
-static chess_value_t index_retreat_left(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    const chess_value_t x = index % 8;
-    if (team == CHESS_WHITE) {  // white retreats down-left
-        if (x == 0 || index - 9 < 0) {
-            return CHESS_NONE;
-        }
-        index -= 9;
-    } else if (team == CHESS_BLACK) {  // black retreats up-left (from black's view)
-        if (x == 0 || index + 7 > 63) {
-            return CHESS_NONE;
-        }
-        index += 7;
+static void set_square(chess_game_t* game, chess_value_t index, chess_value_t id) {
+    clear_square(game, index);
+    if (id != CHESS_NONE) {
+        game->board[index] = id;
+        game->pieces[CHESS_TYPE(id)] |= BIT(index);
+        game->teams[CHESS_TEAM(id)] |= BIT(index);
+        game->hash ^= ZOBRIST_PIECE(id, index);
+#if CHESS_EVALUATION
+        update_evaluation(game, index, id, 1);
+#endif
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
 }
 
-static chess_value_t index_retreat_right(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    const chess_value_t x = index % 8;
-    if (team == CHESS_WHITE) {  // white retreats down-right
-        if (x == 7 || index - 7 < 0) {
-            return CHESS_NONE;
-        }
-        index -= 7;
-    } else if (team == CHESS_BLACK) {  // black retreats up-right (from black's view)
-        if (x == 7 || index + 9 > 63) {
-            return CHESS_NONE;
-        }
-        index += 9;
+static void next_turn(chess_game_t* game) {
+    if (++game->turn > 1) {
+        game->turn = 0;
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
+    game->hash ^= zobrist_black;
 }
 
-static chess_value_t index_retreat(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    if (team == CHESS_WHITE) {  // white retreats down (decreasing rank)
-        index -= 8;
-    } else if (team == CHESS_BLACK) {  // black retreats up (increasing rank)
-        index += 8;
+// the squares involved in each castle, in chess_castle_rights_t bit order
+typedef struct {
+    chess_value_t king;
+    chess_value_t rook;
+    chess_value_t king_to;
+    chess_value_t rook_to;
+    // the squares between king and rook, which must be empty
+    uint64_t empty;
+    // the squares the king passes over and lands on, which must not be attacked
+    uint64_t transit;
+} castle_t;
+
+static const castle_t castles[4] = {
+    {4, 7, 6, 5, BIT(5) | BIT(6), BIT(5) | BIT(6)},
+    {4, 0, 2, 3, BIT(1) | BIT(2) | BIT(3), BIT(2) | BIT(3)},
+    {60, 63, 62, 61, BIT(61) | BIT(62), BIT(61) | BIT(62)},
+    {60, 56, 58, 59, BIT(57) | BIT(58) | BIT(59), BIT(58) | BIT(59)}
+};
+
+// the castle rights lost when a piece moves from or to each square
+static const uint8_t castle_rights_lost[64] = {
+    [0] = CHESS_CASTLE_WHITE_QUEEN_SIDE,
+    [4] = CHESS_CASTLE_WHITE_KING_SIDE | CHESS_CASTLE_WHITE_QUEEN_SIDE,
+    [7] = CHESS_CASTLE_WHITE_KING_SIDE,
+    [56] = CHESS_CASTLE_BLACK_QUEEN_SIDE,
+    [60] = CHESS_CASTLE_BLACK_KING_SIDE | CHESS_CASTLE_BLACK_QUEEN_SIDE,
+    [63] = CHESS_CASTLE_BLACK_KING_SIDE
+};
+
+static void clear_castle_rights(chess_game_t* game, uint8_t rights) {
+    rights &= game->castle_rights;
+    game->castle_rights &= ~rights;
+    while (rights) {
+        const chess_value_t right = BIT_FIRST(rights);
+        rights &= rights - 1;
+        game->hash ^= zobrist_castle[right];
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
 }
 
-static chess_value_t index_left(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    const chess_value_t x = index % 8;
-    if (team == CHESS_WHITE) {  // white's left is decreasing file
-        if (x == 0) {
-            return CHESS_NONE;
-        }
-        index -= 1;
-    } else if (team == CHESS_BLACK) {  // black's left is increasing file (from black's perspective)
-        if (x == 7) {
-            return CHESS_NONE;
-        }
-        index += 1;
+#if CHESS_MAGIC_BITBOARDS
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+#else
+#if defined(__GNUC__) || defined(__clang__)
+#define BIT_LAST(bits) ((chess_value_t)(63 - __builtin_clzll(bits)))
+#else
+static chess_value_t bit_last(uint64_t bits) {
+    chess_value_t result = 0;
+    if (bits > 0xFFFFFFFFULL) { bits >>= 32; result += 32; }
+    if (bits > 0xFFFFULL) { bits >>= 16; result += 16; }
+    if (bits > 0xFFULL) { bits >>= 8; result += 8; }
+    if (bits > 0xFULL) { bits >>= 4; result += 4; }
+    if (bits > 0x3ULL) { bits >>= 2; result += 2; }
+    if (bits > 0x1ULL) { result += 1; }
+    return result;
+}
+#define BIT_LAST(bits) bit_last(bits)
+#endif
+#endif
+
+#define RANK_1 ((uint64_t)0x00000000000000FFULL)
+#define RANK_8 ((uint64_t)0xFF00000000000000ULL)
+#define FILE_A ((uint64_t)0x0101010101010101ULL)
+#define FILE_H ((uint64_t)0x8080808080808080ULL)
+
+// With canonical indexing:
+// White is at bottom (indices 0-15), moves "up" the board (increasing indices, +8)
+// Black is at top (indices 48-63), moves "down" the board (decreasing indices, -8)
+// These tables are filled in once by init_tables() and shared by every game.
+static uint64_t knight_attacks[64];
+static uint64_t king_attacks[64];
+static uint64_t pawn_attacks[2][64];
+static bool tables_initialized = false;
+
+// rank and file steps. The rook directions come first, then the bishop directions
+static const chess_value_t directions[8][2] = {
+    {1, 0}, {0, 1}, {-1, 0}, {0, -1},
+    {1, 1}, {1, -1}, {-1, -1}, {-1, 1}
+};
+#define ROOK_DIRECTIONS (&directions[0])
+#define BISHOP_DIRECTIONS (&directions[4])
+
+// the bit at rank/file, or 0 if that's off the board
+static uint64_t square_bit(chess_value_t rank, chess_value_t file) {
+    if (rank < 0 || rank > 7 || file < 0 || file > 7) {
+        return 0;
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
+    return BIT(rank * 8 + file);
 }
 
-static chess_value_t index_right(chess_value_t team, chess_value_t index) {
-    if (index < 0) return CHESS_NONE;
-    const chess_value_t x = index % 8;
-    if (team == CHESS_WHITE) {  // white's right is increasing file
-        if (x == 7) {
-            return CHESS_NONE;
-        }
-        index += 1;
-    } else if (team == CHESS_BLACK) {  // black's right is decreasing file (from black's perspective)
-        if (x == 0) {
-            return CHESS_NONE;
+// walks four directions from index until the edge of the board or the first occupied square, inclusive
+static uint64_t slide_attacks(chess_value_t index, uint64_t occupied, const chess_value_t (*slide_directions)[2]) {
+    uint64_t result = 0;
+    for (int i = 0; i < 4; ++i) {
+        chess_value_t rank = index / 8;
+        chess_value_t file = index % 8;
+        while (1) {
+            rank += slide_directions[i][0];
+            file += slide_directions[i][1];
+            const uint64_t bit = square_bit(rank, file);
+            if (bit == 0) {
+                break;
+            }
+            result |= bit;
+            if (occupied & bit) {
+                break;
+            }
         }
-        index -= 1;
     }
-    if (index < 0 || index > 63) return CHESS_NONE;
-    return index;
+    return result;
+}
+
+#if CHESS_MAGIC_BITBOARDS
+// Sliding attacks are indexed by the occupancy of the squares that can block them.
+// The multipliers were found offline by random search and hash every blocker
+// subset of their square to a distinct slot (or share a slot with an identical attack set)
+typedef struct {
+    uint64_t mask;
+    uint64_t magic;
+    const uint64_t* attacks;
+    unsigned char shift;
+} magic_t;
+
+static const uint64_t rook_magic_numbers[64] = {
+    0x008000908064c000ULL, 0x0040200040001000ULL, 0x0180100080a0010aULL, 0x8880041000800800ULL,
+    0x1200100201200804ULL, 0x0200020004011008ULL, 0x2180010000800600ULL, 0x0200005088210204ULL,
+    0x0400800040008021ULL, 0x0400400020005000ULL, 0x8240801000200080ULL, 0x8611001004200900ULL,
+    0x008180800c001800ULL, 0x0100800200800400ULL, 0x0a02000102000408ULL, 0x8020802300104280ULL,
+    0x0080004000402000ULL, 0xe010104000402000ULL, 0x0800808010002000ULL, 0xa280210008100100ULL,
+    0x0001818014000800ULL, 0xa002010100080400ULL, 0x0080240001020870ULL, 0x0001020004048845ULL,
+    0x0081826280004004ULL, 0x2020810900284000ULL, 0x0200100080802000ULL, 0x0200080080100080ULL,
+    0x8083080100100500ULL, 0x4406000901000400ULL, 0x0005020080800100ULL, 0x0090204200008114ULL,
+    0x0010400094800420ULL, 0x0900804000802002ULL, 0x0201001841002000ULL, 0x4100080080801000ULL,
+    0x4540040080800800ULL, 0x0002001004040020ULL, 0x0281195814001002ULL, 0x1240800040800100ULL,
+    0x0880042000524004ULL, 0x02c080410206002cULL, 0x0801200241050010ULL, 0x8400080010008080ULL,
+    0x0008000500090010ULL, 0x0082009084020008ULL, 0x4012000108020004ULL, 0x9000104d08860004ULL,
+    0x2004204114800100ULL, 0x0148802112400300ULL, 0x0202842000100880ULL, 0x001b080080900080ULL,
+    0x001a002008100600ULL, 0x0004008004020080ULL, 0x5181000600040300ULL, 0x0000044401128a00ULL,
+    0x8044110480002441ULL, 0x2008110084402202ULL, 0x90806005090010c1ULL, 0x000420310a004a42ULL,
+    0x0023001004020801ULL, 0x0882001008040102ULL, 0x000230088118020cULL, 0x0000019025040042ULL
+};
+
+static const uint64_t bishop_magic_numbers[64] = {
+    0x0045010808008680ULL, 0x2002080204004898ULL, 0x0210009a10400006ULL, 0x0824050200810200ULL,
+    0x0006061105004090ULL, 0x00010108c0000000ULL, 0x0814040282104004ULL, 0x0012012201106800ULL,
+    0x10823014100c1040ULL, 0x0080c2088802808cULL, 0x0281108410404000ULL, 0x0101212041826200ULL,
+    0x0020141028221058ULL, 0x2201020202200202ULL, 0x000082a801482000ULL, 0x0000008401411044ULL,
+    0x0007103014300404ULL, 0x0002091110010100ULL, 0x42140012040c0808ULL, 0x0800808802004020ULL,
+    0x90c4004210140000ULL, 0x0800200900a01000ULL, 0x00d0400201108810ULL, 0x80820183814412a0ULL,
+    0x00a01008202202b4ULL, 0x01c2021a09500402ULL, 0x0084440208042400ULL, 0x800400400c090100ULL,
+    0xba10040010802100ULL, 0xd182009006005000ULL, 0x5011021001009004ULL, 0x0020420200510400ULL,
+    0x0292104000468800ULL, 0x00043009091c0500ULL, 0x0280441000020025ULL, 0x0042820080080080ULL,
+    0x0440101010010040ULL, 0x1000900100808080ULL, 0x0108108120089800ULL, 0x0044010200012682ULL,
+    0xc002500420900400ULL, 0x0040482210710800ULL, 0x0002060024000200ULL, 0x0281020a44000800ULL,
+    0xa0021200a4000200ULL, 0x0001301000840840ULL, 0x2868500108444220ULL, 0x0004111041000200ULL,
+    0x8044020842080200ULL, 0x0000220104210200ULL, 0x0000021201044000ULL, 0x0000280884040028ULL,
+    0x4012114010858003ULL, 0x0000081004082b88ULL, 0x3892700508208002ULL, 0x00220a041b060400ULL,
+    0x0812020284014881ULL, 0x010434a282103100ULL, 0x0490400824020800ULL, 0x4a20002c00208800ULL,
+    0x000000a011020200ULL, 0x4002940a02482202ULL, 0x5100100202140406ULL, 0x02102000840540c1ULL
+};
+
+static magic_t rook_magics[64];
+static magic_t bishop_magics[64];
+static uint64_t rook_table[102400];
+static uint64_t bishop_table[5248];
+
+static unsigned magic_index(const magic_t* magic, uint64_t occupied) {
+#if defined(__BMI2__)
+    return (unsigned)_pext_u64(occupied, magic->mask);
+#else
+    return (unsigned)(((occupied & magic->mask) * magic->magic) >> magic->shift);
+#endif
 }
 
-static void add_en_passant_target(chess_game_t* game, chess_value_t index) {
-    for (int i = 0; i < 16; ++i) {
-        if (game->en_passant_targets[i] == CHESS_NONE) {
-            game->en_passant_targets[i] = index;
-            return;
+static void init_magics(magic_t* magics, const uint64_t* magic_numbers, uint64_t* table, const chess_value_t (*slide_directions)[2]) {
+    for (int index = 0; index < 64; ++index) {
+        magic_t* magic = &magics[index];
+        // the last square of each ray can't block anything behind it
+        const uint64_t edges = ((RANK_1 | RANK_8) & ~(RANK_1 << (8 * (index / 8)))) | ((FILE_A | FILE_H) & ~(FILE_A << (index % 8)));
+        magic->mask = slide_attacks(index, 0, slide_directions) & ~edges;
+        magic->magic = magic_numbers[index];
+        unsigned char bits = 0;
+        for (uint64_t mask = magic->mask; mask; mask &= mask - 1) {
+            ++bits;
         }
+        magic->shift = 64 - bits;
+        magic->attacks = table;
+        // visit every subset of the mask
+        uint64_t occupied = 0;
+        do {
+            table[magic_index(magic, occupied)] = slide_attacks(index, occupied, slide_directions);
+            occupied = (occupied - magic->mask) & magic->mask;
+        } while (occupied);
+        table += BIT(bits);
     }
 }
 
-static void clear_en_passant_target(chess_game_t* game, chess_value_t index) {
-    for (int i = 0; i < 16; ++i) {
-        if (game->en_passant_targets[i] == index) {
-            game->en_passant_targets[i] = CHESS_NONE;
-            return;
-        }
+static uint64_t bishop_attacks(chess_value_t index, uint64_t occupied) {
+    const magic_t* magic = &bishop_magics[index];
+    return magic->attacks[magic_index(magic, occupied)];
+}
+
+static uint64_t rook_attacks(chess_value_t index, uint64_t occupied) {
+    const magic_t* magic = &rook_magics[index];
+    return magic->attacks[magic_index(magic, occupied)];
+}
+#else
+// Each ray runs from a square to the edge of the board in one direction.
+// The attack along it stops at the first blocker, so the ray beyond that blocker is removed
+static uint64_t rays[8][64];
+
+static uint64_t ray_attacks(chess_value_t direction, chess_value_t index, uint64_t occupied) {
+    uint64_t result = rays[direction][index];
+    const uint64_t blockers = result & occupied;
+    if (blockers) {
+        // rays toward higher indices reach their lowest blocker first, the others their highest
+        const chess_value_t step = directions[direction][0] * 8 + directions[direction][1];
+        result ^= rays[direction][step > 0 ? BIT_FIRST(blockers) : BIT_LAST(blockers)];
     }
+    return result;
+}
+
+static uint64_t bishop_attacks(chess_value_t index, uint64_t occupied) {
+    return ray_attacks(4, index, occupied) | ray_attacks(5, index, occupied) | ray_attacks(6, index, occupied) | ray_attacks(7, index, occupied);
+}
+
+static uint64_t rook_attacks(chess_value_t index, uint64_t occupied) {
+    return ray_attacks(0, index, occupied) | ray_attacks(1, index, occupied) | ray_attacks(2, index, occupied) | ray_attacks(3, index, occupied);
+}
+#endif
+
+// splitmix64, used to fill the Zobrist keys
+static uint64_t next_random(uint64_t* state) {
+    uint64_t result = (*state += 0x9E3779B97F4A7C15ULL);
+    result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    result = (result ^ (result >> 27)) * 0x94D049BB133111EBULL;
+    return result ^ (result >> 31);
 }
 
-static chess_value_t is_en_passant_target(const chess_game_t* game, chess_value_t index) {
-    for (int i = 0; i < 16; ++i) {
-        if (game->en_passant_targets[i] == index) {
-            return 1;
+static void init_tables(void) {
+    if (tables_initialized) {
+        return;
+    }
+    uint64_t seed = 0x6368657373ULL;
+    for (int team = 0; team < 2; ++team) {
+        for (int type = 0; type < 6; ++type) {
+            for (int index = 0; index < 64; ++index) {
+                zobrist_pieces[team][type][index] = next_random(&seed);
+            }
         }
     }
-    return 0;
+    for (int i = 0; i < 4; ++i) {
+        zobrist_castle[i] = next_random(&seed);
+    }
+    for (int i = 0; i < 8; ++i) {
+        zobrist_en_passant[i] = next_random(&seed);
+    }
+    zobrist_black = next_random(&seed);
+    for (int index = 0; index < 64; ++index) {
+        const chess_value_t rank = index / 8;
+        const chess_value_t file = index % 8;
+        knight_attacks[index] = square_bit(rank + 2, file - 1) | square_bit(rank + 2, file + 1) |
+                                square_bit(rank - 2, file - 1) | square_bit(rank - 2, file + 1) |
+                                square_bit(rank + 1, file - 2) | square_bit(rank + 1, file + 2) |
+                                square_bit(rank - 1, file - 2) | square_bit(rank - 1, file + 2);
+        king_attacks[index] = 0;
+        for (int i = 0; i < 8; ++i) {
+            king_attacks[index] |= square_bit(rank + directions[i][0], file + directions[i][1]);
+        }
+        pawn_attacks[CHESS_WHITE][index] = square_bit(rank + 1, file - 1) | square_bit(rank + 1, file + 1);
+        pawn_attacks[CHESS_BLACK][index] = square_bit(rank - 1, file - 1) | square_bit(rank - 1, file + 1);
+#if !CHESS_MAGIC_BITBOARDS
+        for (int i = 0; i < 8; ++i) {
+            rays[i][index] = 0;
+            chess_value_t ray_rank = rank + directions[i][0];
+            chess_value_t ray_file = file + directions[i][1];
+            while (square_bit(ray_rank, ray_file)) {
+                rays[i][index] |= square_bit(ray_rank, ray_file);
+                ray_rank += directions[i][0];
+                ray_file += directions[i][1];
+            }
+        }
+#endif
+    }
+#if CHESS_MAGIC_BITBOARDS
+    init_magics(rook_magics, rook_magic_numbers, rook_table, ROOK_DIRECTIONS);
+    init_magics(bishop_magics, bishop_magic_numbers, bishop_table, BISHOP_DIRECTIONS);
+#endif
+    tables_initialized = true;
+}
+
+// sets the en passant square, or clears it with CHESS_NONE
+static void set_en_passant(chess_game_t* game, chess_value_t index) {
+    if (game->en_passant != CHESS_NONE) {
+        game->hash ^= zobrist_en_passant[game->en_passant % 8];
+    }
+    game->en_passant = index;
+    if (index != CHESS_NONE) {
+        game->hash ^= zobrist_en_passant[index % 8];
+    }
+}
+
+// opens en passant over the square the pawn now on index passed, if an enemy pawn is there to take it.
+// Otherwise positions that differ only by a capture nobody can make would hash apart
+static void open_en_passant(chess_game_t* game, chess_value_t index, chess_value_t team) {
+    const chess_value_t passed = team == CHESS_WHITE ? index - 8 : index + 8;
+    if (pawn_attacks[team][passed] & game->pieces[CHESS_PAWN] & game->teams[1 - team]) {
+        set_en_passant(game, passed);
+    }
 }
 
-static chess_value_t en_passant_target_from_move(const chess_game_t* game, chess_value_t index_from, chess_value_t index_to, const chess_value_t* game_board) {
-    if (game == NULL || index_from < 0 || index_from > 63 || index_to < 0 || index_to > 63 || game_board[index_from] == CHESS_NONE) {
+// if the pawn at index_from capturing onto the empty index_to takes a pawn en passant, returns the index of that pawn
+static chess_value_t en_passant_target_from_move(const chess_game_t* game, chess_value_t index_from, chess_value_t index_to) {
+    if (game->en_passant != index_to || index_to == CHESS_NONE) {
         return CHESS_NONE;
     }
-    const chess_value_t id = game_board[index_from];
+    const chess_value_t id = game->board[index_from];
     const chess_value_t team = CHESS_TEAM(id);
-    chess_value_t tmp = index_advance_left(team, index_from);
-    if (tmp != index_to) {
-        tmp = index_advance_right(team, index_from);
-        if (tmp != index_to) {
-            return CHESS_NONE;
-        }
-    }
-    tmp = index_retreat(team, tmp);
-    if (tmp == CHESS_NONE) {
+    if (CHESS_TYPE(id) != CHESS_PAWN || 0 == (pawn_attacks[team][index_from] & BIT(index_to))) {
         return CHESS_NONE;
-    }  // shouldn't happen
-    const chess_value_t id_cmp = game_board[tmp];
-    if (id_cmp == CHESS_NONE) return CHESS_NONE;
-    const chess_type_t type_cmp = CHESS_TYPE(id_cmp);
-    const chess_value_t team_cmp = CHESS_TEAM(id_cmp);
-    if (type_cmp != CHESS_PAWN || team_cmp == team) {
+    }
+    // the victim sits beside us, one rank behind the square we land on
+    const chess_value_t victim = team == CHESS_WHITE ? index_to - 8 : index_to + 8;
+    if (game->board[victim] != CHESS_ID(1 - team, CHESS_PAWN)) {
         return CHESS_NONE;
     }
-    return is_en_passant_target(game, tmp) ? tmp : CHESS_NONE;
+    return victim;
 }
 
-static size_t compute_moves(const chess_game_t* game, chess_index_t index, chess_index_t* out_moves, const chess_id_t* game_board) {
-    const chess_value_t id = game_board[index];
+static uint64_t compute_pawn_moves(const chess_game_t* game, chess_value_t index, chess_value_t team) {
+    const uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    uint64_t result = pawn_attacks[team][index] & game->teams[1 - team];
+    if (en_passant_target_from_move(game, index, game->en_passant) != CHESS_NONE) {
+        result |= BIT(game->en_passant);
+    }
+    uint64_t advance;
+    // White pawns start at indices 8-15 (rank 2), black pawns start at indices 48-55 (rank 7)
+    if (team == CHESS_WHITE) {
+        advance = (BIT(index) << 8) & ~occupied;
+        if (index >= 8 && index < 16) {  // the pawn is on its first move
+            advance |= (advance << 8) & ~occupied;
+        }
+    } else {
+        advance = (BIT(index) >> 8) & ~occupied;
+        if (index >= 48 && index < 56) {  // the pawn is on its first move
+            advance |= (advance >> 8) & ~occupied;
+        }
+    }
+    return result | advance;
+}
+
+// the squares the piece at index can move to, without regard to check or castling
+static uint64_t compute_move_mask(const chess_game_t* game, chess_index_t index) {
+    const chess_value_t id = game->board[index];
     if (id == CHESS_NONE) {
         return 0;
     }
     const chess_value_t type = CHESS_TYPE(id);
     const chess_value_t team = CHESS_TEAM(id);
-    chess_value_t result = 0;
+    const uint64_t own = game->teams[team];
+    const uint64_t occupied = own | game->teams[1 - team];
     switch (type) {
         case CHESS_PAWN:
-            // White pawns start at indices 8-15 (rank 2), black pawns start at indices 48-55 (rank 7)
-            if ((team == CHESS_WHITE && index >= 8 && index < 16) || (team == CHESS_BLACK && index >= 48 && index < 56)) {  // the pawn is on its first move
-                chess_value_t tmp = index_advance(team, index);
-                if (tmp != CHESS_NONE) {
-                    if (game_board[tmp] == CHESS_NONE) {
-                        out_moves[result++] = tmp;
-                    }
-                    chess_value_t attack = index_advance_left(team, index);
-                    if (attack != CHESS_NONE && game_board[attack] != CHESS_NONE && CHESS_TEAM(game_board[attack]) != team) {
-                        out_moves[result++] = attack;
-                    }
-                    attack = index_advance_right(team, index);
-                    if (attack != CHESS_NONE && game_board[attack] != CHESS_NONE && CHESS_TEAM(game_board[attack]) != team) {
-                        out_moves[result++] = attack;
-                    }
-                    // en passant
-                    attack = en_passant_target_from_move(game, index, index_advance_left(team, index), game_board);
-                    if (attack != CHESS_NONE) {
-                        out_moves[result++] = index_advance_left(team, index);
-                    }
-                    attack = en_passant_target_from_move(game, index, index_advance_right(team, index), game_board);
-                    if (attack != CHESS_NONE) {
-                        out_moves[result++] = index_advance_right(team, index);
-                    }
-                    if (game_board[tmp] == CHESS_NONE) {
-                        tmp = index_advance(team, tmp);
-                        if (tmp != CHESS_NONE && game_board[tmp] == CHESS_NONE) {
-                            out_moves[result++] = tmp;
-                        }
-                    }
-                }
-            } else {
-                chess_value_t tmp = index_advance(team, index);
-                if (tmp != CHESS_NONE) {
-                    if (game_board[tmp] == CHESS_NONE) {
-                        out_moves[result++] = tmp;
-                    }
-                    chess_value_t attack = index_advance_left(team, index);
-                    if (attack != CHESS_NONE && game_board[attack] != CHESS_NONE && CHESS_TEAM(game_board[attack]) != team) {
-                        out_moves[result++] = attack;
-                    }
-                    attack = index_advance_right(team, index);
-                    if (attack != CHESS_NONE && game_board[attack] != CHESS_NONE && CHESS_TEAM(game_board[attack]) != team) {
-                        out_moves[result++] = attack;
-                    }
-                    // en passant
-                    attack = en_passant_target_from_move(game, index, index_advance_left(team, index), game_board);
-                    if (attack != CHESS_NONE) {
-                        out_moves[result++] = index_advance_left(team, index);
-                    }
-                    attack = en_passant_target_from_move(game, index, index_advance_right(team, index), game_board);
-                    if (attack != CHESS_NONE) {
-                        out_moves[result++] = index_advance_right(team, index);
-                    }
-                }
-            }
-            break;
+            return compute_pawn_moves(game, index, team);
         case CHESS_BISHOP:
-            move_until_obstacle(index_advance_left, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_advance_right, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_retreat_left, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_retreat_right, team, index, game_board, out_moves, &result);
-            break;
+            return bishop_attacks(index, occupied) & ~own;
         case CHESS_ROOK:
-            move_until_obstacle(index_advance, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_retreat, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_left, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_right, team, index, game_board, out_moves, &result);
-            break;
-        case CHESS_KNIGHT: {
-            chess_value_t tmp = index_advance(team, index);
-            if (tmp != CHESS_NONE) {
-                tmp = index_advance(team, tmp);
-                if (tmp != CHESS_NONE) {
-                    chess_value_t tmp2 = index_left(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                    tmp2 = index_right(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                }
-            }
-            tmp = index_retreat(team, index);
-            if (tmp != CHESS_NONE) {
-                tmp = index_retreat(team, tmp);
-                if (tmp != CHESS_NONE) {
-                    chess_value_t tmp2 = index_left(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                    tmp2 = index_right(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                }
-            }
-            tmp = index_left(team, index);
-            if (tmp != CHESS_NONE) {
-                tmp = index_left(team, tmp);
-                if (tmp != CHESS_NONE) {
-                    chess_value_t tmp2 = index_advance(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                    tmp2 = index_retreat(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                }
-            }
-            tmp = index_right(team, index);
-            if (tmp != CHESS_NONE) {
-                tmp = index_right(team, tmp);
-                if (tmp != CHESS_NONE) {
-                    chess_value_t tmp2 = index_advance(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                    tmp2 = index_retreat(team, tmp);
-                    if (tmp2 != CHESS_NONE) {
-                        if (game_board[tmp2] == CHESS_NONE || CHESS_TEAM(game_board[tmp2]) != team) {
-                            out_moves[result++] = tmp2;
-                        }
-                    }
-                }
-            }
-        } break;
+            return rook_attacks(index, occupied) & ~own;
+        case CHESS_KNIGHT:
+            return knight_attacks[index] & ~own;
         case CHESS_QUEEN:
-            move_until_obstacle(index_advance_left, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_advance_right, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_retreat_left, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_retreat_right, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_advance, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_retreat, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_left, team, index, game_board, out_moves, &result);
-            move_until_obstacle(index_right, team, index, game_board, out_moves, &result);
-            break;
-        case CHESS_KING: {
-            chess_value_t tmp = index_advance(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_retreat(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_left(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_right(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_advance_left(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_advance_right(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_retreat_left(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-            tmp = index_retreat_right(team, index);
-            if (tmp != CHESS_NONE) {
-                if (game_board[tmp] == CHESS_NONE || CHESS_TEAM(game_board[tmp]) != team) {
-                    out_moves[result++] = tmp;
-                }
-            }
-        } break;
+            return (bishop_attacks(index, occupied) | rook_attacks(index, occupied)) & ~own;
+        case CHESS_KING:
+            return king_attacks[index] & ~own;
         default:
             return 0;
     }
+}
+
+static size_t mask_to_moves(uint64_t moves, chess_index_t* out_moves) {
+    size_t result = 0;
+    while (moves) {
+        out_moves[result++] = bit_pop(&moves);
+    }
     return result;
 }
 
@@ -447,265 +668,741 @@ bool chess_contains_move(const chess_index_t* moves, size_t moves_size, chess_in
     return false;
 }
 
-static chess_value_t is_checked_king(const chess_game_t* game, chess_value_t king_index, const chess_value_t* game_board) {
-    const chess_value_t id = game_board[king_index];
-    const chess_value_t team = CHESS_TEAM(id);
-    chess_value_t tmp_moves[64];
-    chess_value_t tmp_moves_size;
-    for (int i = 0; i < 64; ++i) {
-        const chess_value_t tmp_id = game_board[i];
-        if (tmp_id != CHESS_NONE) {
-            const chess_value_t tmp_team = CHESS_TEAM(tmp_id);
-            if (tmp_team != team) {
-                tmp_moves_size = compute_moves(game, i, tmp_moves, game_board);
-                if (chess_contains_move(tmp_moves, tmp_moves_size, king_index)) {
-                    return 1;
-                }
-            }
-        }
+// works backward from the square: a piece of by_team attacks it if the same kind of piece standing on it would attack that piece
+static bool is_attacked(const chess_game_t* game, chess_value_t index, chess_value_t by_team) {
+    const uint64_t attackers = game->teams[by_team];
+    if (pawn_attacks[1 - by_team][index] & attackers & game->pieces[CHESS_PAWN]) {
+        return true;
+    }
+    if (knight_attacks[index] & attackers & game->pieces[CHESS_KNIGHT]) {
+        return true;
+    }
+    if (king_attacks[index] & attackers & game->pieces[CHESS_KING]) {
+        return true;
+    }
+    const uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    const uint64_t queens = game->pieces[CHESS_QUEEN];
+    if (bishop_attacks(index, occupied) & attackers & (game->pieces[CHESS_BISHOP] | queens)) {
+        return true;
+    }
+    return 0 != (rook_attacks(index, occupied) & attackers & (game->pieces[CHESS_ROOK] | queens));
+}
+
+static chess_value_t is_checked_king(const chess_game_t* game, chess_value_t king_index) {
+    if (king_index == CHESS_NONE) {
+        return 0;
+    }
+    return is_attacked(game, king_index, 1 - CHESS_TEAM(game->board[king_index]));
+}
+
+// every piece of by_team that attacks the square, given the occupancy
+static uint64_t attackers_of(const chess_game_t* game, chess_value_t index, chess_value_t by_team, uint64_t occupied) {
+    const uint64_t queens = game->pieces[CHESS_QUEEN];
+    return game->teams[by_team] & ((pawn_attacks[1 - by_team][index] & game->pieces[CHESS_PAWN]) |
+                                   (knight_attacks[index] & game->pieces[CHESS_KNIGHT]) |
+                                   (king_attacks[index] & game->pieces[CHESS_KING]) |
+                                   (bishop_attacks(index, occupied) & (game->pieces[CHESS_BISHOP] | queens)) |
+                                   (rook_attacks(index, occupied) & (game->pieces[CHESS_ROOK] | queens)));
+}
+
+// the squares strictly between two indices on the same rank, file or diagonal, otherwise 0
+static uint64_t squares_between(chess_value_t index_a, chess_value_t index_b) {
+    if (rook_attacks(index_a, 0) & BIT(index_b)) {
+        return rook_attacks(index_a, BIT(index_b)) & rook_attacks(index_b, BIT(index_a));
+    }
+    if (bishop_attacks(index_a, 0) & BIT(index_b)) {
+        return bishop_attacks(index_a, BIT(index_b)) & bishop_attacks(index_b, BIT(index_a));
     }
     return 0;
 }
 
-static chess_value_t compute_check_moves(const chess_game_t* game, chess_value_t index, chess_value_t king_index, const chess_value_t* game_board, chess_value_t* out_moves) {
-    const chess_value_t id = game_board[index];
-    const chess_value_t king_id = game_board[king_index];
-    chess_value_t result = 0;
-    if (king_id == CHESS_NONE || CHESS_TYPE(king_id) != CHESS_KING) {
-        return 0;  // shouldn't happen
+// the whole rank, file or diagonal running through both indices, otherwise 0
+static uint64_t squares_in_line(chess_value_t index_a, chess_value_t index_b) {
+    if (rook_attacks(index_a, 0) & BIT(index_b)) {
+        return (rook_attacks(index_a, 0) & rook_attacks(index_b, 0)) | BIT(index_a) | BIT(index_b);
     }
-    if (id == CHESS_NONE) {
-        return 0;
+    if (bishop_attacks(index_a, 0) & BIT(index_b)) {
+        return (bishop_attacks(index_a, 0) & bishop_attacks(index_b, 0)) | BIT(index_a) | BIT(index_b);
     }
-    const chess_value_t team = CHESS_TEAM(id);
-    if (team != CHESS_TEAM(king_id)) {
-        return 0;
+    return 0;
+}
+
+// what the legality filter needs to know about a team's king, computed once per position
+typedef struct {
+    chess_value_t king_index;
+    // the enemy pieces giving check
+    uint64_t checkers;
+    // our pieces that can only move along the line between the king and the piece pinning them
+    uint64_t pinned;
+    // where a piece other than the king may move: anywhere unless in check, then only onto the checker or in its way
+    uint64_t evasions;
+} king_safety_t;
+
+static void compute_king_safety(const chess_game_t* game, chess_value_t team, king_safety_t* out_safety) {
+    const chess_value_t king_index = game->kings[team];
+    out_safety->king_index = king_index;
+    out_safety->checkers = 0;
+    out_safety->pinned = 0;
+    out_safety->evasions = ~(uint64_t)0;
+    if (king_index == CHESS_NONE) {
+        return;
     }
-    chess_value_t tmp_moves[64];
-    chess_value_t tmp_moves_size;
-    chess_value_t tmp_board[64];
-    memcpy(tmp_board, game_board, sizeof(tmp_board));
-    tmp_moves_size = compute_moves(game, index, tmp_moves, game_board);
-    for (int i = 0; i < tmp_moves_size; ++i) {
-        const chess_value_t to_index = tmp_moves[i];
-        // commit to temp
-        const chess_value_t victim = tmp_board[to_index];
-        tmp_board[to_index] = tmp_board[index];
-        tmp_board[index] = CHESS_NONE;
-        chess_value_t test_king = king_index;
-        if (index == king_index) {
-            test_king = to_index;
-        }
-        const char checked = is_checked_king(game, test_king, tmp_board);
-        // rollback
-        tmp_board[index] = tmp_board[to_index];
-        tmp_board[to_index] = victim;
-        if (!checked) {
-            out_moves[result++] = to_index;
+    const chess_value_t enemy = 1 - team;
+    const uint64_t enemies = game->teams[enemy];
+    const uint64_t occupied = game->teams[team] | enemies;
+    out_safety->checkers = attackers_of(game, king_index, enemy, occupied);
+    if (out_safety->checkers) {
+        if (out_safety->checkers & (out_safety->checkers - 1)) {
+            out_safety->evasions = 0;  // double check, only the king can move
+        } else {
+            out_safety->evasions = squares_between(king_index, BIT_FIRST(out_safety->checkers)) | out_safety->checkers;
+        }
+    }
+    // sliders that would reach the king if our pieces weren't in the way
+    const uint64_t queens = game->pieces[CHESS_QUEEN];
+    uint64_t snipers = enemies & ((rook_attacks(king_index, enemies) & (game->pieces[CHESS_ROOK] | queens)) |
+                                  (bishop_attacks(king_index, enemies) & (game->pieces[CHESS_BISHOP] | queens)));
+    while (snipers) {
+        const uint64_t blockers = squares_between(king_index, bit_pop(&snipers)) & occupied;
+        if (blockers && 0 == (blockers & (blockers - 1)) && (blockers & game->teams[team])) {
+            out_safety->pinned |= blockers;
         }
     }
-    return result;
 }
 
-static void eliminate_checked_moves(const chess_game_t* game, chess_value_t index, chess_value_t* in_out_moves, chess_value_t* in_out_moves_size) {
+// the squares the piece at index can legally move to, not counting castling
+static uint64_t compute_legal_moves(const chess_game_t* game, chess_value_t index, const king_safety_t* safety) {
     const chess_value_t id = game->board[index];
+    uint64_t moves = compute_move_mask(game, index);
+    const chess_value_t king_index = safety->king_index;
+    if (moves == 0 || king_index == CHESS_NONE) {
+        return moves;
+    }
     const chess_value_t team = CHESS_TEAM(id);
-    const chess_value_t king_index = game->kings[team];
-    chess_value_t tmp_board[64];
-    memcpy(tmp_board, game->board, sizeof(tmp_board));
-    for (int i = 0; i < *in_out_moves_size; ++i) {
-        const chess_value_t to_index = in_out_moves[i];
-        // commit to temp
-        const chess_value_t victim = tmp_board[to_index];
-        tmp_board[to_index] = tmp_board[index];
-        tmp_board[index] = CHESS_NONE;
-        chess_value_t test_king = king_index;
-        if (index == king_index) {
-            test_king = to_index;
-        }
-        const char checked = is_checked_king(game, test_king, tmp_board);
-        // rollback
-        tmp_board[index] = tmp_board[to_index];
-        tmp_board[to_index] = victim;
-        if (checked) {
-            if (i < *in_out_moves_size - 1) {
-                for (int j = i + 1; j < *in_out_moves_size; ++j) {
-                    in_out_moves[j - 1] = in_out_moves[j];
-                }
-                --(*in_out_moves_size);
-                --i;
+    const uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    if (index == king_index) {
+        // take the king off the board so it can't shelter behind itself from a slider
+        const uint64_t occupied_without_king = occupied & ~BIT(index);
+        uint64_t candidates = moves;
+        moves = 0;
+        while (candidates) {
+            const chess_value_t to_index = bit_pop(&candidates);
+            if (0 == attackers_of(game, to_index, 1 - team, occupied_without_king)) {
+                moves |= BIT(to_index);
             }
         }
+        return moves;
+    }
+    // an en passant capture removes a pawn from a square it doesn't land on,
+    // which the masks can't account for, so those are tested separately
+    uint64_t en_passant = 0;
+    if (CHESS_TYPE(id) == CHESS_PAWN) {
+        en_passant = moves & pawn_attacks[team][index] & ~occupied;
+        moves &= ~en_passant;
+    }
+    moves &= safety->evasions;
+    if (safety->pinned & BIT(index)) {
+        moves &= squares_in_line(king_index, index);
+    }
+    while (en_passant) {
+        const chess_value_t to_index = bit_pop(&en_passant);
+        // the king is safe if nothing but the taken pawn attacks it once both pawns are off their squares
+        const uint64_t captured = BIT(en_passant_target_from_move(game, index, to_index));
+        const uint64_t occupied_after = (occupied ^ BIT(index) ^ captured) | BIT(to_index);
+        if (0 == (attackers_of(game, king_index, 1 - team, occupied_after) & ~captured)) {
+            moves |= BIT(to_index);
+        }
     }
+    return moves;
 }
 
-void chess_init(chess_game_t* out_game) {
-    out_game->turn = 0;
-    out_game->score[0] = 0;
-    out_game->score[1] = 0;
-    out_game->no_castle[0] = 0;
-    out_game->no_castle[1] = 0;
-    
-    for (int i = 0; i < 16; ++i) {
-        out_game->en_passant_targets[i] = CHESS_NONE;
-    }
+// an empty board, white to move
+static void clear_game(chess_game_t* game) {
+    game->turn = 0;
+    game->score[0] = 0;
+    game->score[1] = 0;
+    game->castle_rights = CHESS_CASTLE_ALL;
+    game->kings[0] = CHESS_NONE;
+    game->kings[1] = CHESS_NONE;
+    game->en_passant = CHESS_NONE;
     for (int i = 0; i < 64; ++i) {
-        out_game->board[i] = CHESS_NONE;
+        game->board[i] = CHESS_NONE;
     }
+    memset(game->pieces, 0, sizeof(game->pieces));
+    memset(game->teams, 0, sizeof(game->teams));
+    // white to move with every castle open hashes to just the pieces
+    game->hash = 0;
+#if CHESS_EVALUATION
+    game->phase = 0;
+    game->evaluation[0] = 0;
+    game->evaluation[1] = 0;
+#endif
+    game->halfmove = 0;
+    game->fullmove = 1;
+#if CHESS_HISTORY_SIZE
+    game->history_top = 0;
+    game->history_count = 0;
+#endif
+}
+
+void chess_init(chess_game_t* out_game) {
+    init_tables();
+    clear_game(out_game);
     
     // Canonical chess layout: White at bottom (rank 1-2), Black at top (rank 7-8)
     // Rank 2 - White pawns (indices 8CHESS_NONE5)
     for (int i = 0; i < 8; ++i) {
-        out_game->board[8 + i] = CHESS_ID(0, CHESS_PAWN);
+        set_square(out_game, 8 + i, CHESS_ID(0, CHESS_PAWN));
     }
     // Rank 1 - White pieces (indices 0-7)
-    out_game->board[0] = CHESS_ID(0, CHESS_ROOK);      // a1
-    out_game->board[1] = CHESS_ID(0, CHESS_KNIGHT);    // b1
-    out_game->board[2] = CHESS_ID(0, CHESS_BISHOP);    // c1
-    out_game->board[3] = CHESS_ID(0, CHESS_QUEEN);     // d1
-    out_game->board[4] = CHESS_ID(0, CHESS_KING);      // e1
-    out_game->board[5] = CHESS_ID(0, CHESS_BISHOP);    // f1
-    out_game->board[6] = CHESS_ID(0, CHESS_KNIGHT);    // g1
-    out_game->board[7] = CHESS_ID(0, CHESS_ROOK);      // h1
+    set_square(out_game, 0, CHESS_ID(0, CHESS_ROOK));      // a1
+    set_square(out_game, 1, CHESS_ID(0, CHESS_KNIGHT));    // b1
+    set_square(out_game, 2, CHESS_ID(0, CHESS_BISHOP));    // c1
+    set_square(out_game, 3, CHESS_ID(0, CHESS_QUEEN));     // d1
+    set_square(out_game, 4, CHESS_ID(0, CHESS_KING));      // e1
+    set_square(out_game, 5, CHESS_ID(0, CHESS_BISHOP));    // f1
+    set_square(out_game, 6, CHESS_ID(0, CHESS_KNIGHT));    // g1
+    set_square(out_game, 7, CHESS_ID(0, CHESS_ROOK));      // h1
     out_game->kings[0] = 4;  // e1
 
     // Rank 7 - Black pawns (indices 48-55)
     for (int i = 0; i < 8; ++i) {
-        out_game->board[48 + i] = CHESS_ID(1, CHESS_PAWN);
+        set_square(out_game, 48 + i, CHESS_ID(1, CHESS_PAWN));
     }
     // Rank 8 - Black pieces (indices 56-63)
-    out_game->board[56] = CHESS_ID(1, CHESS_ROOK);     // a8
-    out_game->board[57] = CHESS_ID(1, CHESS_KNIGHT);   // b8
-    out_game->board[58] = CHESS_ID(1, CHESS_BISHOP);   // c8
-    out_game->board[59] = CHESS_ID(1, CHESS_QUEEN);    // d8
-    out_game->board[60] = CHESS_ID(1, CHESS_KING);     // e8
-    out_game->board[61] = CHESS_ID(1, CHESS_BISHOP);   // f8
-    out_game->board[62] = CHESS_ID(1, CHESS_KNIGHT);   // g8
-    out_game->board[63] = CHESS_ID(1, CHESS_ROOK);     // h8
+    set_square(out_game, 56, CHESS_ID(1, CHESS_ROOK));     // a8
+    set_square(out_game, 57, CHESS_ID(1, CHESS_KNIGHT));   // b8
+    set_square(out_game, 58, CHESS_ID(1, CHESS_BISHOP));   // c8
+    set_square(out_game, 59, CHESS_ID(1, CHESS_QUEEN));    // d8
+    set_square(out_game, 60, CHESS_ID(1, CHESS_KING));     // e8
+    set_square(out_game, 61, CHESS_ID(1, CHESS_BISHOP));   // f8
+    set_square(out_game, 62, CHESS_ID(1, CHESS_KNIGHT));   // g8
+    set_square(out_game, 63, CHESS_ID(1, CHESS_ROOK));     // h8
     out_game->kings[1] = 60;  // e8
 }
 
-static chess_value_t compute_castling(const chess_game_t* game, chess_value_t index, chess_value_t queen_side) {
-    // do not call if if not your turn.
-    const chess_value_t id = game->board[index];
-    const chess_type_t type = CHESS_TYPE(id);
-    const chess_value_t team = CHESS_TEAM(id);
-    chess_value_t index_other = CHESS_NONE;
-    if (type != CHESS_KING && type != CHESS_ROOK) {
-        return CHESS_NONE;
+// the letters for each chess_type_t, white in upper case
+static const char fen_pieces[2][7] = {"PBRNQK", "pbrnqk"};
+
+static chess_value_t fen_piece_id(char ch) {
+    switch (ch) {
+        case 'P': return CHESS_ID(CHESS_WHITE, CHESS_PAWN);
+        case 'B': return CHESS_ID(CHESS_WHITE, CHESS_BISHOP);
+        case 'R': return CHESS_ID(CHESS_WHITE, CHESS_ROOK);
+        case 'N': return CHESS_ID(CHESS_WHITE, CHESS_KNIGHT);
+        case 'Q': return CHESS_ID(CHESS_WHITE, CHESS_QUEEN);
+        case 'K': return CHESS_ID(CHESS_WHITE, CHESS_KING);
+        case 'p': return CHESS_ID(CHESS_BLACK, CHESS_PAWN);
+        case 'b': return CHESS_ID(CHESS_BLACK, CHESS_BISHOP);
+        case 'r': return CHESS_ID(CHESS_BLACK, CHESS_ROOK);
+        case 'n': return CHESS_ID(CHESS_BLACK, CHESS_KNIGHT);
+        case 'q': return CHESS_ID(CHESS_BLACK, CHESS_QUEEN);
+        case 'k': return CHESS_ID(CHESS_BLACK, CHESS_KING);
+        default: return CHESS_NONE;
     }
+}
 
-    if (game->no_castle[team]) {
-        return CHESS_NONE;
+// a move counter, which is all digits and fits in 16 bits
+static bool parse_counter(const char** cursor, uint16_t* out_value) {
+    const char* str = *cursor;
+    if (*str < '0' || *str > '9') {
+        return false;
     }
-    
-    if (team == CHESS_WHITE) {  // White castling (rank 1, indices 0-7)
-        if (type == CHESS_KING) {
-            if (queen_side) {
-                index_other = 0;  // Queen-side rook at a1
-                // no pieces between king and rook?
-                for (int i = index_other + 1; i < index; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
-            } else {
-                index_other = 7;  // King-side rook at h1
-                // no pieces between king and rook?
-                for (int i = index + 1; i < index_other; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
+    unsigned long value = 0;
+    while (*str >= '0' && *str <= '9') {
+        value = value * 10 + (unsigned long)(*str++ - '0');
+        if (value > 0xFFFF) {
+            return false;
+        }
+    }
+    *cursor = str;
+    *out_value = (uint16_t)value;
+    return true;
+}
+
+// writes a move counter in decimal, returning the end
+static char* write_counter(char* cursor, unsigned int value) {
+    char digits[5];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (count) {
+        *cursor++ = digits[--count];
+    }
+    return cursor;
+}
+
+// credits each team with the value of the opponent's pieces missing from a full set
+static void compute_scores(chess_game_t* game) {
+    static const chess_value_t full_set[6] = {8, 2, 2, 2, 1, 1};
+    for (int team = 0; team < 2; ++team) {
+        int score = 0;
+        for (int type = 0; type < 6; ++type) {
+            const size_t count = BIT_COUNT(game->pieces[type] & game->teams[1 - team]);
+            score += (full_set[type] - (int)count) * scoring[type];
+        }
+        game->score[team] = score > 0 ? (chess_score_t)score : 0;
+    }
+}
+
+// works out the evaluation from scratch
+static void compute_evaluation(const chess_game_t* game, int16_t* out_evaluation, uint8_t* out_phase) {
+    int middlegame = 0;
+    int endgame = 0;
+    int phase = 0;
+    uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    while (occupied) {
+        const chess_value_t index = bit_pop(&occupied);
+        const chess_value_t id = game->board[index];
+        middlegame += piece_value(id, index, 0);
+        endgame += piece_value(id, index, 1);
+        phase += phase_weights[CHESS_TYPE(id)];
+    }
+    out_evaluation[0] = (int16_t)middlegame;
+    out_evaluation[1] = (int16_t)endgame;
+    *out_phase = (uint8_t)phase;
+}
+
+chess_result_t chess_from_fen(chess_game_t* out_game, const char* fen) {
+    if (out_game == NULL || fen == NULL) {
+        return CHESS_INVALID;
+    }
+    init_tables();
+    // parse into a scratch game so out_game is untouched on failure
+    chess_game_t game;
+    clear_game(&game);
+    const char* cursor = fen;
+    // pieces, from rank 8 down to rank 1
+    chess_value_t rank = 7;
+    chess_value_t file = 0;
+    while (*cursor != ' ') {
+        const char ch = *cursor++;
+        if (ch >= '1' && ch <= '8') {
+            file += ch - '0';
+            if (file > 8) {
+                return CHESS_INVALID;
+            }
+        } else if (ch == '/') {
+            if (file != 8 || rank == 0) {
+                return CHESS_INVALID;
             }
+            --rank;
+            file = 0;
         } else {
-            queen_side = index == 0;  // Queen-side rook
-            index_other = 4;  // White king at e1
-            if (queen_side) {
-                for (int i = index + 1; i < index_other; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
-            } else {
-                for (int i = index_other + 1; i < index; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
+            const chess_value_t id = fen_piece_id(ch);
+            // this also stops at the terminator
+            if (id == CHESS_NONE || file > 7) {
+                return CHESS_INVALID;
+            }
+            const chess_value_t index = rank * 8 + file++;
+            if (CHESS_TYPE(id) == CHESS_KING) {
+                if (game.kings[CHESS_TEAM(id)] != CHESS_NONE) {
+                    return CHESS_INVALID;
                 }
+                game.kings[CHESS_TEAM(id)] = index;
             }
+            set_square(&game, index, id);
         }
-    } else {  // Black castling (rank 8, indices 56-63)
-        if (type == CHESS_KING) {
-            if (queen_side) {
-                index_other = 56;  // Queen-side rook at a8
-                // no pieces between king and rook?
-                for (int i = index_other + 1; i < index; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
-            } else {
-                index_other = 63;  // King-side rook at h8
-                // no pieces between king and rook?
-                for (int i = index + 1; i < index_other; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
+    }
+    if (rank != 0 || file != 8 || game.kings[0] == CHESS_NONE || game.kings[1] == CHESS_NONE) {
+        return CHESS_INVALID;
+    }
+    ++cursor;
+    // side to move
+    if (*cursor == 'b') {
+        next_turn(&game);
+    } else if (*cursor != 'w') {
+        return CHESS_INVALID;
+    }
+    ++cursor;
+    if (*cursor++ != ' ') {
+        return CHESS_INVALID;
+    }
+    // castle rights
+    uint8_t rights = CHESS_CASTLE_NONE;
+    if (*cursor == '-') {
+        ++cursor;
+    } else {
+        while (*cursor != ' ' && *cursor != '\0') {
+            switch (*cursor++) {
+                case 'K': rights |= CHESS_CASTLE_WHITE_KING_SIDE; break;
+                case 'Q': rights |= CHESS_CASTLE_WHITE_QUEEN_SIDE; break;
+                case 'k': rights |= CHESS_CASTLE_BLACK_KING_SIDE; break;
+                case 'q': rights |= CHESS_CASTLE_BLACK_QUEEN_SIDE; break;
+                default: return CHESS_INVALID;
             }
-        } else {
-            queen_side = index == 56;  // Queen-side rook
-            index_other = 60;  // Black king at e8
-            if (queen_side) {
-                for (int i = index + 1; i < index_other; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
-            } else {
-                for (int i = index_other + 1; i < index; ++i) {
-                    if (game->board[i] != CHESS_NONE) {
-                        return CHESS_NONE;
-                    }
-                }
+        }
+    }
+    // a right is only kept if its king and rook are still home
+    for (int i = 0; i < 4; ++i) {
+        const castle_t* castle = &castles[i];
+        const chess_value_t team = i / 2;
+        if (game.board[castle->king] != CHESS_ID(team, CHESS_KING) || game.board[castle->rook] != CHESS_ID(team, CHESS_ROOK)) {
+            rights &= ~(1 << i);
+        }
+    }
+    clear_castle_rights(&game, ~rights);
+    if (*cursor++ != ' ') {
+        return CHESS_INVALID;
+    }
+    // en passant square. The pawn that just passed it has to be there
+    if (*cursor == '-') {
+        ++cursor;
+    } else {
+        if (cursor[0] < 'a' || cursor[0] > 'h' || cursor[1] != (game.turn == CHESS_WHITE ? '6' : '3')) {
+            return CHESS_INVALID;
+        }
+        const chess_value_t index = (cursor[1] - '1') * 8 + (cursor[0] - 'a');
+        const chess_value_t pawn = game.turn == CHESS_WHITE ? index - 8 : index + 8;
+        if (game.board[pawn] != CHESS_ID(1 - game.turn, CHESS_PAWN) || game.board[index] != CHESS_NONE) {
+            return CHESS_INVALID;
+        }
+        open_en_passant(&game, pawn, 1 - game.turn);
+        cursor += 2;
+    }
+    // the move counters are optional
+    if (*cursor == ' ' && cursor[1] != '\0') {
+        ++cursor;
+        if (!parse_counter(&cursor, &game.halfmove)) {
+            return CHESS_INVALID;
+        }
+        if (*cursor == ' ' && cursor[1] != '\0') {
+            ++cursor;
+            if (!parse_counter(&cursor, &game.fullmove)) {
+                return CHESS_INVALID;
+            }
+            if (game.fullmove == 0) {
+                game.fullmove = 1;
             }
         }
     }
-    
-    // now we have to see if a piece is attacking any square between this one and the other index, inclusive
-    chess_value_t tmp_moves[64];
-    chess_value_t tmp_moves_size;
-    if (index_other > index) {
-        for (int i = index; i <= index_other; ++i) {
-            for (int j = 0; j < 64; ++j) {
-                const chess_value_t cmp_id = game->board[j];
-                if (CHESS_NONE != cmp_id && CHESS_TEAM(cmp_id) != team) {
-                    // opposing piece
-                    tmp_moves_size = compute_moves(game, j, tmp_moves, game->board);
-                    if (chess_contains_move(tmp_moves, tmp_moves_size, i)) {
-                        return CHESS_NONE;
-                    }
-                }
+    if (*cursor != ' ' && *cursor != '\0') {
+        return CHESS_INVALID;
+    }
+    compute_scores(&game);
+    *out_game = game;
+    return CHESS_SUCCESS;
+}
+
+chess_result_t chess_to_fen(const chess_game_t* game, char* out_buffer) {
+    if (game == NULL || out_buffer == NULL) {
+        return CHESS_INVALID;
+    }
+    char* cursor = out_buffer;
+    for (chess_value_t rank = 7; rank >= 0; --rank) {
+        chess_value_t empty = 0;
+        for (chess_value_t file = 0; file < 8; ++file) {
+            const chess_value_t id = game->board[rank * 8 + file];
+            if (id == CHESS_NONE) {
+                ++empty;
+                continue;
             }
+            if (empty) {
+                *cursor++ = '0' + empty;
+                empty = 0;
+            }
+            *cursor++ = fen_pieces[CHESS_TEAM(id)][CHESS_TYPE(id)];
+        }
+        if (empty) {
+            *cursor++ = '0' + empty;
+        }
+        if (rank) {
+            *cursor++ = '/';
+        }
+    }
+    *cursor++ = ' ';
+    *cursor++ = game->turn == CHESS_WHITE ? 'w' : 'b';
+    *cursor++ = ' ';
+    // castle rights, in KQkq order
+    if (game->castle_rights == CHESS_CASTLE_NONE) {
+        *cursor++ = '-';
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (game->castle_rights & (1 << i)) {
+            *cursor++ = fen_pieces[i / 2][i % 2 ? CHESS_QUEEN : CHESS_KING];
         }
+    }
+    *cursor++ = ' ';
+    if (game->en_passant == CHESS_NONE) {
+        *cursor++ = '-';
     } else {
-        for (int i = index_other; i <= index; ++i) {
-            for (int j = 0; j < 64; ++j) {
-                const chess_value_t cmp_id = game->board[j];
-                if (CHESS_NONE != cmp_id && CHESS_TEAM(cmp_id) != team) {
-                    // opposing piece
-                    tmp_moves_size = compute_moves(game, j, tmp_moves, game->board);
-                    if (chess_contains_move(tmp_moves, tmp_moves_size, i)) {
-                        return CHESS_NONE;
-                    }
+        *cursor++ = 'a' + game->en_passant % 8;
+        *cursor++ = '1' + game->en_passant / 8;
+    }
+    *cursor++ = ' ';
+    cursor = write_counter(cursor, game->halfmove);
+    *cursor++ = ' ';
+    cursor = write_counter(cursor, game->fullmove);
+    *cursor = '\0';
+    return CHESS_SUCCESS;
+}
+
+// the extra codes in a packed position. The rest are the piece ids themselves
+#define PACKED_WHITE_CASTLE_ROOK 6
+#define PACKED_EN_PASSANT_PAWN 7
+#define PACKED_BLACK_CASTLE_ROOK 14
+#define PACKED_BLACK_KING_UP 15
+
+chess_result_t chess_pack(const chess_game_t* game, chess_packed_t* out_packed) {
+    if (game == NULL || out_packed == NULL) {
+        return CHESS_INVALID;
+    }
+    uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    // the black king carries the turn, so both kings have to be there
+    if (BIT_COUNT(occupied) > 32 || game->kings[CHESS_WHITE] == CHESS_NONE || game->kings[CHESS_BLACK] == CHESS_NONE) {
+        return CHESS_INVALID;
+    }
+    memset(out_packed->bytes, 0, sizeof(out_packed->bytes));
+    for (int i = 0; i < 8; ++i) {
+        out_packed->bytes[i] = (uint8_t)(occupied >> (i * 8));
+    }
+    // the pawn that passed the en passant square
+    chess_value_t en_passant_pawn = CHESS_NONE;
+    if (game->en_passant != CHESS_NONE) {
+        en_passant_pawn = game->turn == CHESS_WHITE ? game->en_passant - 8 : game->en_passant + 8;
+    }
+    uint8_t* codes = out_packed->bytes + 8;
+    for (int i = 0; occupied; ++i) {
+        const chess_value_t index = bit_pop(&occupied);
+        const chess_value_t id = game->board[index];
+        uint8_t code = (uint8_t)id;
+        if (index == en_passant_pawn) {
+            code = PACKED_EN_PASSANT_PAWN;
+        } else if (id == CHESS_ID(CHESS_BLACK, CHESS_KING) && game->turn == CHESS_BLACK) {
+            code = PACKED_BLACK_KING_UP;
+        } else if (CHESS_TYPE(id) == CHESS_ROOK && (castle_rights_lost[index] & game->castle_rights)) {
+            code = CHESS_TEAM(id) == CHESS_WHITE ? PACKED_WHITE_CASTLE_ROOK : PACKED_BLACK_CASTLE_ROOK;
+        }
+        codes[i / 2] |= (uint8_t)(code << ((i % 2) * 4));
+    }
+    return CHESS_SUCCESS;
+}
+
+chess_result_t chess_unpack(chess_game_t* out_game, const chess_packed_t* packed) {
+    if (out_game == NULL || packed == NULL) {
+        return CHESS_INVALID;
+    }
+    init_tables();
+    uint64_t occupied = 0;
+    for (int i = 0; i < 8; ++i) {
+        occupied |= (uint64_t)packed->bytes[i] << (i * 8);
+    }
+    if (BIT_COUNT(occupied) > 32) {
+        return CHESS_INVALID;
+    }
+    // unpack into a scratch game so out_game is untouched on failure
+    chess_game_t game;
+    clear_game(&game);
+    uint8_t rights = CHESS_CASTLE_NONE;
+    // the bitboards and the key are built up here and stored once, which is
+    // much quicker than going through set_square() for each piece
+    uint64_t pieces[6] = {0, 0, 0, 0, 0, 0};
+    uint64_t teams[2] = {0, 0};
+    uint64_t hash = 0;
+    chess_value_t en_passant_pawn = CHESS_NONE;
+    const uint8_t* codes = packed->bytes + 8;
+    for (int i = 0; occupied; ++i) {
+        const chess_value_t index = bit_pop(&occupied);
+        const uint8_t code = (codes[i / 2] >> ((i % 2) * 4)) & 15;
+        chess_value_t id = (chess_value_t)code;
+        switch (code) {
+            case PACKED_WHITE_CASTLE_ROOK:
+            case PACKED_BLACK_CASTLE_ROOK:
+                // a rook that can still castle stands on one of its own team's corners
+                if (code == PACKED_WHITE_CASTLE_ROOK ? (index != 0 && index != 7) : (index != 56 && index != 63)) {
+                    return CHESS_INVALID;
+                }
+                id = CHESS_ID(code == PACKED_WHITE_CASTLE_ROOK ? CHESS_WHITE : CHESS_BLACK, CHESS_ROOK);
+                rights |= castle_rights_lost[index];
+                break;
+            case PACKED_EN_PASSANT_PAWN:
+                // a pawn that just advanced two squares stands on rank 4 if white or rank 5 if black
+                if (en_passant_pawn != CHESS_NONE || index < 24 || index > 39) {
+                    return CHESS_INVALID;
                 }
+                en_passant_pawn = index;
+                id = CHESS_ID(index < 32 ? CHESS_WHITE : CHESS_BLACK, CHESS_PAWN);
+                break;
+            case PACKED_BLACK_KING_UP:
+                id = CHESS_ID(CHESS_BLACK, CHESS_KING);
+                game.turn = CHESS_BLACK;
+                hash ^= zobrist_black;
+                break;
+            default:
+                break;
+        }
+        if (CHESS_TYPE(id) == CHESS_KING) {
+            if (game.kings[CHESS_TEAM(id)] != CHESS_NONE) {
+                return CHESS_INVALID;
             }
+            game.kings[CHESS_TEAM(id)] = index;
+        }
+        game.board[index] = id;
+        pieces[CHESS_TYPE(id)] |= BIT(index);
+        teams[CHESS_TEAM(id)] |= BIT(index);
+        hash ^= ZOBRIST_PIECE(id, index);
+    }
+    memcpy(game.pieces, pieces, sizeof(pieces));
+    memcpy(game.teams, teams, sizeof(teams));
+    game.hash = hash;
+    if (game.kings[CHESS_WHITE] == CHESS_NONE || game.kings[CHESS_BLACK] == CHESS_NONE) {
+        return CHESS_INVALID;
+    }
+    // a castle rook without its king at home can't castle
+    for (int i = 0; i < 4; ++i) {
+        if (game.board[castles[i].king] != CHESS_ID(i / 2, CHESS_KING)) {
+            rights &= ~(1 << i);
+        }
+    }
+    clear_castle_rights(&game, ~rights);
+    if (en_passant_pawn != CHESS_NONE) {
+        // the pawn has to belong to the team that just moved, and the square it passed has to be empty
+        const chess_value_t passed = game.turn == CHESS_WHITE ? en_passant_pawn + 8 : en_passant_pawn - 8;
+        if (CHESS_TEAM(game.board[en_passant_pawn]) == game.turn || game.board[passed] != CHESS_NONE) {
+            return CHESS_INVALID;
+        }
+        open_en_passant(&game, en_passant_pawn, 1 - game.turn);
+    }
+    compute_scores(&game);
+#if CHESS_EVALUATION
+    compute_evaluation(&game, game.evaluation, &game.phase);
+#endif
+    *out_game = game;
+    return CHESS_SUCCESS;
+}
+
+// the squares the king can castle to, as a mask. Call only when the king isn't in check
+static uint64_t compute_castling(const chess_game_t* game, chess_value_t team) {
+    uint64_t result = 0;
+    const uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    for (int i = team * 2; i < team * 2 + 2; ++i) {
+        const castle_t* castle = &castles[i];
+        // the right goes as soon as the king or rook moves or the rook is taken, so both are home
+        if (0 == (game->castle_rights & (1 << i)) || (occupied & castle->empty)) {
+            continue;
+        }
+        // the king may not cross or land on an attacked square
+        uint64_t transit = castle->transit;
+        bool attacked = false;
+        while (transit && !attacked) {
+            attacked = is_attacked(game, bit_pop(&transit), 1 - team);
+        }
+        if (!attacked) {
+            result |= BIT(castle->king_to);
         }
     }
+    return result;
+}
+
+// the castle a king's destination square belongs to
+static const castle_t* castle_from_king_to(chess_value_t index_to) {
+    switch (index_to) {
+        case 6: return &castles[0];
+        case 2: return &castles[1];
+        case 62: return &castles[2];
+        default: return &castles[3];
+    }
+}
+
+// plays a move without checking it. out_undo may be NULL
+static chess_value_t make_move(chess_game_t* game, chess_move_t move, chess_undo_t* out_undo) {
+    const chess_value_t index_from = CHESS_MOVE_FROM(move);
+    const chess_value_t index_to = CHESS_MOVE_TO(move);
+    const chess_move_flags_t flags = CHESS_MOVE_FLAGS(move);
+    const chess_value_t id = game->board[index_from];
+    const chess_type_t type = CHESS_TYPE(id);
+    const chess_value_t team = CHESS_TEAM(id);
+    if (out_undo != NULL) {
+        out_undo->move = move;
+        out_undo->captured = CHESS_NONE;
+        out_undo->en_passant = game->en_passant;
+        out_undo->castle_rights = game->castle_rights;
+        out_undo->score = game->score[team];
+        out_undo->hash = game->hash;
+        out_undo->halfmove = game->halfmove;
+    }
+#if CHESS_HISTORY_SIZE
+    if (out_undo != NULL) {
+        out_undo->history_count = game->history_count;
+        out_undo->history_key = game->history_count == CHESS_HISTORY_SIZE ? game->history[game->history_top] : 0;
+    }
+    // the position being left goes into the history, for finding repetitions
+    game->history[game->history_top] = game->hash;
+    game->history_top = (game->history_top + 1) & (CHESS_HISTORY_SIZE - 1);
+    if (game->history_count < CHESS_HISTORY_SIZE) {
+        ++game->history_count;
+    }
+#endif
+    // a capture or a pawn move sets this back to 0 below
+    if (game->halfmove < 0xFFFF) {
+        ++game->halfmove;
+    }
+    if (team == CHESS_BLACK) {
+        ++game->fullmove;
+    }
+    clear_castle_rights(game, castle_rights_lost[index_from] | castle_rights_lost[index_to]);
+    set_en_passant(game, CHESS_NONE);
+    if (flags == CHESS_MOVE_CASTLE) {
+        const castle_t* castle = castle_from_king_to(index_to);
+        clear_square(game, index_from);
+        clear_square(game, castle->rook);
+        set_square(game, index_to, id);
+        set_square(game, castle->rook_to, CHESS_ID(team, CHESS_ROOK));
+        game->kings[team] = index_to;
+        next_turn(game);
+        return CHESS_NONE;
+    }
+    chess_value_t result = CHESS_NONE;
+    if (flags == CHESS_MOVE_EN_PASSANT) {
+        // the victim sits one rank behind the square we land on
+        result = team == CHESS_WHITE ? index_to - 8 : index_to + 8;
+    }
+    if (game->board[index_to] != CHESS_NONE) {
+        result = index_to;
+    }
+    if (result != CHESS_NONE) {
+        const chess_value_t victim = game->board[result];
+        game->score[team] += scoring[CHESS_TYPE(victim)];
+        if (CHESS_TYPE(victim) == CHESS_KING) {
+            game->kings[1 - team] = CHESS_NONE;
+        }
+        clear_square(game, result);
+        if (out_undo != NULL) {
+            out_undo->captured = victim;
+        }
+        game->halfmove = 0;
+    }
+    if (type == CHESS_PAWN) {
+        game->halfmove = 0;
+    }
+    set_square(game, index_to, id);
+    if (flags == CHESS_MOVE_DOUBLE_PUSH) {
+        // a pawn that advanced two squares can be taken en passant
+        open_en_passant(game, index_to, team);
+    }
+    next_turn(game);
+    if (type == CHESS_KING) {
+        game->kings[team] = index_to;
+    }
+    clear_square(game, index_from);
+    const chess_value_t promotion = CHESS_MOVE_PROMOTION(move);
+    if (promotion != CHESS_NONE) {
+        set_square(game, index_to, CHESS_ID(team, promotion));
+    }
+    return result;
+}
 
-    return index_other;
+// where a piece of the team that is up can go, castling included
+static uint64_t compute_destinations(const chess_game_t* game, chess_value_t index, const king_safety_t* safety) {
+    uint64_t moves = compute_legal_moves(game, index, safety);
+    if (safety->checkers == 0 && index == safety->king_index) {
+        moves |= compute_castling(game, CHESS_TEAM(game->board[index]));
+    }
+    return moves;
 }
+
 chess_value_t chess_move(chess_game_t* game, chess_index_t index_from, chess_index_t index_to) {
     if (game == NULL || index_from < 0 || index_from > 63 || index_to < 0 || index_to > 63 || index_from == index_to) {
         return -2;
@@ -717,89 +1414,103 @@ chess_value_t chess_move(chess_game_t* game, chess_index_t index_from, chess_ind
     if (game->turn != team) {
         return -2;
     }
-    chess_value_t tmp_moves[64];
-    chess_value_t tmp_moves_size = 0;
-    chess_value_t index_other = CHESS_NONE;
-    const chess_value_t king_index = game->kings[team];
-    if (is_checked_king(game, king_index, game->board)) {
-        tmp_moves_size = compute_check_moves(game, index_from, king_index, game->board, tmp_moves);
-    } else {
-        tmp_moves_size = compute_moves(game, index_from, tmp_moves, game->board);
-        // castle if possible
-        index_other = compute_castling(game, index_from, 0);
-        if (index_other != index_to) {
-            index_other = compute_castling(game, index_from, 1);
-        }
-        if (index_other == index_to) {
-            game->no_castle[team] = 1;
-            const chess_value_t other_id = game->board[index_other];
-            game->board[index_to] = game->board[index_from];
-            game->board[index_from] = other_id;
-            if (type == CHESS_KING) {
-                game->kings[team] = index_to;
-                
+    king_safety_t safety;
+    compute_king_safety(game, team, &safety);
+    if (safety.checkers == 0 && index_from == safety.king_index) {
+        // castle if possible. Moving onto the rook is taken to mean the same thing
+        const uint64_t castles_to = compute_castling(game, team);
+        if (castles_to) {
+            for (int i = team * 2; i < team * 2 + 2; ++i) {
+                if (index_to == castles[i].rook && game->board[index_to] == CHESS_ID(team, CHESS_ROOK)) {
+                    index_to = castles[i].king_to;
+                }
+            }
+            if (castles_to & BIT(index_to)) {
+                return make_move(game, CHESS_MOVE(index_from, index_to, CHESS_MOVE_CASTLE), NULL);
             }
-            // still our turn
-            return CHESS_NONE;
         }
     }
-    if (chess_contains_move(tmp_moves, tmp_moves_size, index_to)) {
-        char added = 0;
-        chess_value_t result = CHESS_NONE;
-        chess_score_t score = 0;
+    if (compute_legal_moves(game, index_from, &safety) & BIT(index_to)) {
+        chess_move_flags_t flags = CHESS_MOVE_NORMAL;
         if (type == CHESS_PAWN) {
-            clear_en_passant_target(game, index_from);
-            // check for en passant target eligibility.
             // we can tell if it's the first move advanced by two
             // simply by checking the index for a difference of 16
-            // the only way it gets that is moving two and the only
-            // time that can happen is first move
-            if (team == CHESS_WHITE) {
-                if (index_from == index_to - 16) {  // White moved up two squares
-                    add_en_passant_target(game, index_to);
-                    added = 1;
-                }
-            } else if (team == CHESS_BLACK) {
-                if (index_from == index_to + 16) {  // Black moved down two squares
-                    add_en_passant_target(game, index_to);
-                    added = 1;
-                }
-            }
-            const chess_value_t attack_index = en_passant_target_from_move(game, index_from, index_to, game->board);
-            if (attack_index != CHESS_NONE) {
-                chess_id_t target_id = CHESS_TYPE(game->board[attack_index]);
-                score = scoring[target_id]; 
-                game->board[attack_index] = CHESS_NONE;
-                result = attack_index;
-                if(target_id==CHESS_KING) {
-                    game->kings[1-team] = CHESS_NONE;
-                }
-            }
-        }
-        if (game->board[index_to] != CHESS_NONE && CHESS_TEAM(game->board[index_to]) != team) {
-            result = index_to;
-        }
-        if(result!=CHESS_NONE) {
-            if(score==0 & game->board[result]!=CHESS_NONE) {
-                score = scoring[CHESS_TYPE(game->board[result])];
+            if (index_from == index_to - 16 || index_from == index_to + 16) {
+                flags = CHESS_MOVE_DOUBLE_PUSH;
+            } else if (en_passant_target_from_move(game, index_from, index_to) != CHESS_NONE) {
+                flags = CHESS_MOVE_EN_PASSANT;
             }
-            chess_id_t target_id = CHESS_TYPE(game->board[result]);
-            game->score[team] += score;
         }
-        game->board[index_to] = game->board[index_from];
-        if (!added && game->board[index_to] != CHESS_NONE) {
-            clear_en_passant_target(game, index_to);
-        }
-        if (++game->turn > 1) {
-            game->turn = 0;
+        return make_move(game, CHESS_MOVE(index_from, index_to, flags), NULL);
+    }
+    return -2;
+}
+
+chess_index_t chess_make_move(chess_game_t* game, chess_move_t move, chess_undo_t* out_undo) {
+    if (game == NULL || CHESS_MOVE_FROM(move) == CHESS_MOVE_TO(move)) {
+        return -2;
+    }
+    const chess_value_t id = game->board[CHESS_MOVE_FROM(move)];
+    if (id == CHESS_NONE || CHESS_TEAM(id) != game->turn) {
+        return -2;
+    }
+    return make_move(game, move, out_undo);
+}
+
+void chess_unmake_move(chess_game_t* game, const chess_undo_t* undo) {
+    if (game == NULL || undo == NULL) {
+        return;
+    }
+    const chess_value_t index_from = CHESS_MOVE_FROM(undo->move);
+    const chess_value_t index_to = CHESS_MOVE_TO(undo->move);
+    const chess_move_flags_t flags = CHESS_MOVE_FLAGS(undo->move);
+    chess_value_t id = game->board[index_to];
+    const chess_value_t team = CHESS_TEAM(id);
+    game->en_passant = undo->en_passant;
+    game->castle_rights = undo->castle_rights;
+    game->score[team] = undo->score;
+    game->halfmove = undo->halfmove;
+#if CHESS_HISTORY_SIZE
+    // the key on top of the history is the position being returned to. Put back
+    // whatever it overwrote, so a full ring loses nothing to a make and unmake
+    game->history_top = (game->history_top - 1) & (CHESS_HISTORY_SIZE - 1);
+    game->history[game->history_top] = undo->history_key;
+    game->history_count = undo->history_count;
+#endif
+    if (team == CHESS_BLACK) {
+        --game->fullmove;
+    }
+    if (flags == CHESS_MOVE_CASTLE) {
+        const castle_t* castle = castle_from_king_to(index_to);
+        clear_square(game, index_to);
+        clear_square(game, castle->rook_to);
+        set_square(game, index_from, id);
+        set_square(game, castle->rook, CHESS_ID(team, CHESS_ROOK));
+        game->kings[team] = index_from;
+        game->turn = team;
+        game->hash = undo->hash;
+        return;
+    }
+    if (CHESS_MOVE_PROMOTION(undo->move) != CHESS_NONE) {
+        id = CHESS_ID(team, CHESS_PAWN);
+    }
+    clear_square(game, index_to);
+    set_square(game, index_from, id);
+    if (CHESS_TYPE(id) == CHESS_KING) {
+        game->kings[team] = index_from;
+    }
+    if (undo->captured != CHESS_NONE) {
+        chess_value_t captured_index = index_to;
+        if (flags == CHESS_MOVE_EN_PASSANT) {
+            captured_index = team == CHESS_WHITE ? index_to - 8 : index_to + 8;
         }
-        if (CHESS_TYPE(id) == CHESS_KING) {
-            game->kings[team] = index_to;
+        set_square(game, captured_index, undo->captured);
+        if (CHESS_TYPE(undo->captured) == CHESS_KING) {
+            game->kings[1 - team] = captured_index;
         }
-        game->board[index_from] = CHESS_NONE;
-        return result;
     }
-    return -2;
+    game->turn = team;
+    game->hash = undo->hash;
 }
 
 size_t chess_compute_moves(const chess_game_t* game, chess_index_t index, chess_index_t* out_moves) {
@@ -810,20 +1521,46 @@ size_t chess_compute_moves(const chess_game_t* game, chess_index_t index, chess_
     if (game->turn != CHESS_TEAM(id)) {
         return 0;
     }
-    chess_value_t result = 0;
-    const chess_value_t king_index = game->kings[CHESS_TEAM(id)];
-    if (is_checked_king(game, king_index, game->board)) {
-        result = compute_check_moves(game, index, king_index, game->board, out_moves);
-    } else {
-        result = compute_moves(game, index, out_moves, game->board);
-        eliminate_checked_moves(game, index, out_moves, &result);
-        chess_value_t index_other = compute_castling(game, index, 0);
-        if (index_other != CHESS_NONE) {
-            out_moves[result++] = index_other;
-        }
-        index_other = compute_castling(game, index, 1);
-        if (index_other != CHESS_NONE) {
-            out_moves[result++] = index_other;
+    king_safety_t safety;
+    compute_king_safety(game, CHESS_TEAM(id), &safety);
+    return mask_to_moves(compute_destinations(game, index, &safety), out_moves);
+}
+
+uint64_t chess_legal_destinations(const chess_game_t* game, chess_index_t index) {
+    if (game == NULL || index < 0 || index > 63) {
+        return 0;
+    }
+    const chess_value_t id = game->board[index];
+    if (id == CHESS_NONE || game->turn != CHESS_TEAM(id)) {
+        return 0;
+    }
+    king_safety_t safety;
+    compute_king_safety(game, CHESS_TEAM(id), &safety);
+    if (safety.evasions == 0 && index != safety.king_index) {
+        return 0;  // double check
+    }
+    return compute_destinations(game, index, &safety);
+}
+
+size_t chess_legal_destination_map(const chess_game_t* game, uint64_t* out_masks) {
+    if (game == NULL || out_masks == NULL) {
+        return 0;
+    }
+    memset(out_masks, 0, 64 * sizeof(uint64_t));
+    const chess_value_t team = game->turn;
+    // the check and pin analysis is shared by every piece
+    king_safety_t safety;
+    compute_king_safety(game, team, &safety);
+    uint64_t pieces = game->teams[team];
+    if (safety.evasions == 0) {
+        pieces &= game->pieces[CHESS_KING];  // double check
+    }
+    size_t result = 0;
+    while (pieces) {
+        const chess_value_t index = bit_pop(&pieces);
+        out_masks[index] = compute_destinations(game, index, &safety);
+        if (out_masks[index] != 0) {
+            ++result;
         }
     }
     return result;
@@ -840,76 +1577,119 @@ chess_id_t chess_index_to_id(const chess_game_t* game, chess_index_t index) {
     return game->board[index];
 }
 
+// whether team has any legal move, stopping at the first one found
+static bool has_legal_move(const chess_game_t* game, chess_value_t team, const king_safety_t* safety) {
+    uint64_t pieces = game->teams[team];
+    if (safety->king_index != CHESS_NONE) {
+        // the king first, since in check it's the piece most likely to have a way out
+        if (compute_legal_moves(game, safety->king_index, safety)) {
+            return true;
+        }
+        pieces &= ~BIT(safety->king_index);
+    }
+    if (safety->evasions == 0) {
+        return false;  // double check, and the king is stuck
+    }
+    while (pieces) {
+        if (compute_legal_moves(game, bit_pop(&pieces), safety)) {
+            return true;
+        }
+    }
+    // castling can only add a move when nothing else can move, so it's checked last
+    return safety->checkers == 0 && safety->king_index != CHESS_NONE && compute_castling(game, team) != 0;
+}
+
+bool chess_has_legal_move(const chess_game_t* game) {
+    if (game == NULL) {
+        return false;
+    }
+    king_safety_t safety;
+    compute_king_safety(game, game->turn, &safety);
+    return has_legal_move(game, game->turn, &safety);
+}
+
+size_t chess_count_legal_moves(const chess_game_t* game) {
+    if (game == NULL) {
+        return 0;
+    }
+    const chess_value_t team = game->turn;
+    const uint64_t last_rank = team == CHESS_WHITE ? RANK_8 : RANK_1;
+    king_safety_t safety;
+    compute_king_safety(game, team, &safety);
+    uint64_t pieces = game->teams[team];
+    if (safety.evasions == 0) {
+        pieces &= game->pieces[CHESS_KING];  // double check
+    }
+    size_t result = 0;
+    while (pieces) {
+        const chess_value_t index = bit_pop(&pieces);
+        const chess_type_t type = CHESS_TYPE(game->board[index]);
+        uint64_t moves = compute_legal_moves(game, index, &safety);
+        if (type == CHESS_PAWN) {
+            // one move for each piece it can promote to
+            result += 3 * BIT_COUNT(moves & last_rank);
+        }
+        result += BIT_COUNT(moves);
+        if (safety.checkers == 0 && type == CHESS_KING) {
+            result += BIT_COUNT(compute_castling(game, team));
+        }
+    }
+    return result;
+}
+
 bool chess_status(const chess_game_t* game, chess_status_t* out_white_status, chess_status_t* out_black_status) {
-    if(game==NULL) return false;
-    chess_value_t index = game->kings[(int)CHESS_WHITE];
-    if(index==CHESS_NONE) {
-        return CHESS_CHECKMATE;
-    }
-    index = game->kings[(int)CHESS_BLACK];
-    if(index==CHESS_NONE) {
-        return CHESS_CHECKMATE;
-    }
-    if(out_white_status!=NULL) {
-        *out_white_status = CHESS_NORMAL;
-    }
-    if(out_black_status!=NULL) {
-        *out_black_status = CHESS_NORMAL;
-    }
-    chess_value_t moves[64]; 
-    bool has_move = false;
-    bool set_white = false;
-    bool set_black = false;
-    bool can_continue =true;
-    for(int i = 0;i<64;++i) {
-        if(game->board[i]!=CHESS_NONE) {
-            if(CHESS_KING==CHESS_TYPE(game->board[i])) {
-                if (is_checked_king(game, i, game->board)) {
-                    if (0 == chess_compute_moves(game, i, moves)) {
-                        if(CHESS_TEAM(game->board[i]==CHESS_WHITE)) {
-                            if(out_white_status!=NULL) {
-                                *out_white_status = CHESS_CHECKMATE;
-                            }
-                            can_continue = false;
-                            set_white = true;
-                        } else {
-                            if(out_black_status!=NULL) {
-                                *out_black_status = CHESS_CHECKMATE;
-                            }
-                            can_continue = false;
-                            set_black = true;
-                        }
-                    } else {
-                        if(CHESS_TEAM(game->board[i]==CHESS_WHITE)) {
-                            if(out_white_status!=NULL) {
-                                *out_white_status = CHESS_CHECK;
-                            }
-                            set_white = true;
-                        } else {
-                            if(out_black_status!=NULL) {
-                                *out_black_status = CHESS_CHECK;
-                            }
-                            set_black = true;
-                        }
-                    }
-                }
+    if (game == NULL) {
+        return false;
+    }
+    chess_status_t status[2] = {CHESS_NORMAL, CHESS_NORMAL};
+    bool result = true;
+    if (game->kings[CHESS_WHITE] == CHESS_NONE || game->kings[CHESS_BLACK] == CHESS_NONE) {
+        // a side without a king has lost
+        status[CHESS_WHITE] = game->kings[CHESS_WHITE] == CHESS_NONE ? CHESS_CHECKMATE : CHESS_NORMAL;
+        status[CHESS_BLACK] = game->kings[CHESS_BLACK] == CHESS_NONE ? CHESS_CHECKMATE : CHESS_NORMAL;
+        result = false;
+    } else {
+        const chess_value_t team = game->turn;
+        const chess_value_t enemy = 1 - team;
+        king_safety_t safety;
+        compute_king_safety(game, team, &safety);
+        // the side that just moved can't legally be in check, but a set up position might have it so
+        if (is_checked_king(game, game->kings[enemy])) {
+            status[enemy] = CHESS_CHECK;
+        }
+        if (has_legal_move(game, team, &safety)) {
+            if (safety.checkers) {
+                status[team] = CHESS_CHECK;
+            }
+        } else if (safety.checkers) {
+            status[team] = CHESS_CHECKMATE;
+            result = false;
+        } else {
+            status[CHESS_WHITE] = CHESS_STALEMATE;
+            status[CHESS_BLACK] = CHESS_STALEMATE;
+            result = false;
+        }
+        if (result) {
+            chess_status_t draw = CHESS_NORMAL;
+            if (game->halfmove >= 100) {
+                draw = CHESS_DRAW_FIFTY_MOVES;
+            } else if (chess_repetitions(game) >= 2) {
+                draw = CHESS_DRAW_REPETITION;
             }
-            if(can_continue && 0!=chess_compute_moves(game,i,moves)) {
-                has_move = true;
+            if (draw != CHESS_NORMAL) {
+                status[CHESS_WHITE] = draw;
+                status[CHESS_BLACK] = draw;
+                result = false;
             }
         }
     }
-    
-    if(!has_move && !set_white && !set_black) {
-        can_continue = false;
-        if(out_white_status!=NULL) {
-            *out_white_status = CHESS_STALEMATE;
-        }
-        if(out_black_status!=NULL) {
-            *out_black_status = CHESS_STALEMATE;
-        }
+    if (out_white_status != NULL) {
+        *out_white_status = status[CHESS_WHITE];
+    }
+    if (out_black_status != NULL) {
+        *out_black_status = status[CHESS_BLACK];
     }
-    return can_continue;
+    return result;
 }
 
 chess_result_t chess_promote_pawn(chess_game_t* game, chess_index_t index, chess_type_t new_type) {
@@ -934,8 +1714,7 @@ chess_result_t chess_promote_pawn(chess_game_t* game, chess_index_t index, chess
             return CHESS_INVALID;
         }
     }
-    clear_en_passant_target(game, index);
-    game->board[index] = CHESS_ID(team, new_type);
+    set_square(game, index, CHESS_ID(team, new_type));
     // puts\("DEBUG: PROMOTE SUCCESS");
     return CHESS_SUCCESS;
 }
@@ -956,7 +1735,210 @@ chess_score_t chess_score(const chess_game_t* game, chess_team_t team) {
     }
     return game->score[team];
 }
+chess_score_t chess_type_score(chess_type_t type) {
+    if (type < CHESS_PAWN || type > CHESS_KING) {
+        return 0;
+    }
+    return scoring[type];
+}
+
+int chess_evaluate(const chess_game_t* game) {
+    if (game == NULL) {
+        return 0;
+    }
+#if CHESS_EVALUATION
+    const int16_t* evaluation = game->evaluation;
+    int phase = game->phase;
+#else
+    int16_t evaluation[2];
+    uint8_t scanned_phase;
+    compute_evaluation(game, evaluation, &scanned_phase);
+    int phase = scanned_phase;
+#endif
+    // promotions can push the phase past where it started
+    if (phase > PHASE_MAX) {
+        phase = PHASE_MAX;
+    }
+    const int result = (evaluation[0] * phase + evaluation[1] * (PHASE_MAX - phase)) / PHASE_MAX;
+    return game->turn == CHESS_WHITE ? result : -result;
+}
+
+// the sliders that see the square through occupied, for the x-rays uncovered as pieces come off
+static uint64_t slider_attackers_of(const chess_game_t* game, chess_value_t index, uint64_t occupied) {
+    const uint64_t queens = game->pieces[CHESS_QUEEN];
+    return (bishop_attacks(index, occupied) & (game->pieces[CHESS_BISHOP] | queens)) |
+           (rook_attacks(index, occupied) & (game->pieces[CHESS_ROOK] | queens));
+}
+
+int chess_see(const chess_game_t* game, chess_index_t index_from, chess_index_t index_to) {
+    // the piece types cheapest first, which isn't the order they're numbered in
+    static const chess_type_t by_value[6] = {CHESS_PAWN, CHESS_KNIGHT, CHESS_BISHOP, CHESS_ROOK, CHESS_QUEEN, CHESS_KING};
+    if (game == NULL || index_from < 0 || index_from > 63 || index_to < 0 || index_to > 63 || index_from == index_to) {
+        return 0;
+    }
+    const chess_id_t id = game->board[index_from];
+    if (id == CHESS_NONE) {
+        return 0;
+    }
+    chess_value_t team = CHESS_TEAM(id);
+    chess_type_t type = CHESS_TYPE(id);
+    uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    const bool last_rank = 0 != (BIT(index_to) & (RANK_1 | RANK_8));
+    const int promotion = scoring[CHESS_QUEEN] - scoring[CHESS_PAWN];
+    // gains[n] is what the side making the nth capture is up if the sequence stops after it
+    int gains[32];
+    int depth = 0;
+    if (game->board[index_to] != CHESS_NONE) {
+        gains[0] = scoring[CHESS_TYPE(game->board[index_to])];
+    } else if (type == CHESS_PAWN && index_to == game->en_passant && (index_from & 7) != (index_to & 7)) {
+        gains[0] = scoring[CHESS_PAWN];
+        occupied &= ~BIT(team == CHESS_WHITE ? index_to - 8 : index_to + 8);
+    } else {
+        gains[0] = 0;
+    }
+    int on_square = scoring[type];
+    if (type == CHESS_PAWN && last_rank) {
+        gains[0] += promotion;
+        on_square = scoring[CHESS_QUEEN];
+    }
+    // everything that can reach the square, from both sides, collected once
+    uint64_t attackers = attackers_of(game, index_to, CHESS_WHITE, occupied) | attackers_of(game, index_to, CHESS_BLACK, occupied);
+    uint64_t from_bit = BIT(index_from);
+    while (depth < 31) {
+        occupied &= ~from_bit;
+        attackers = (attackers | slider_attackers_of(game, index_to, occupied)) & occupied;
+        team = 1 - team;
+        const uint64_t ours = attackers & game->teams[team];
+        if (ours == 0) {
+            break;
+        }
+        // the least valuable attacker takes next
+        int order = 0;
+        while (order < 6 && 0 == (ours & game->pieces[by_value[order]])) {
+            ++order;
+        }
+        if (order == 6) {
+            break;
+        }
+        type = by_value[order];
+        // a king can't take back if the square is still defended
+        if (type == CHESS_KING && (attackers & game->teams[1 - team]) != 0) {
+            break;
+        }
+        from_bit = ours & game->pieces[type];
+        from_bit &= ~from_bit + 1;
+        ++depth;
+        gains[depth] = on_square - gains[depth - 1];
+        on_square = scoring[type];
+        if (type == CHESS_PAWN && last_rank) {
+            gains[depth] += promotion;
+            on_square = scoring[CHESS_QUEEN];
+        }
+    }
+    // each side stops capturing once it would do better to stand pat
+    while (depth > 0) {
+        if (gains[depth] > -gains[depth - 1]) {
+            gains[depth - 1] = -gains[depth];
+        }
+        --depth;
+    }
+    return gains[0];
+}
+
 bool chess_can_castle(const chess_game_t* game, chess_team_t team) {
     if(game==NULL || team<0 || team>1) return false;
-    return !game->no_castle[team];
-}
\ No newline at end of file
+    return 0 != (game->castle_rights & (team == CHESS_WHITE ? CHESS_CASTLE_WHITE_KING_SIDE | CHESS_CASTLE_WHITE_QUEEN_SIDE : CHESS_CASTLE_BLACK_KING_SIDE | CHESS_CASTLE_BLACK_QUEEN_SIDE));
+}
+
+chess_castle_rights_t chess_castle_rights(const chess_game_t* game) {
+    if (game == NULL) {
+        return CHESS_CASTLE_NONE;
+    }
+    return (chess_castle_rights_t)game->castle_rights;
+}
+
+static void add_moves(chess_move_list_t* list, chess_value_t index_from, uint64_t to_mask, chess_move_flags_t flags) {
+    while (to_mask) {
+        list->moves[list->size++] = CHESS_MOVE(index_from, bit_pop(&to_mask), flags);
+    }
+}
+
+size_t chess_generate_moves(const chess_game_t* game, chess_move_list_t* out_moves) {
+    if (game == NULL || out_moves == NULL) {
+        return 0;
+    }
+    out_moves->size = 0;
+    const chess_value_t team = game->turn;
+    const uint64_t occupied = game->teams[CHESS_WHITE] | game->teams[CHESS_BLACK];
+    const uint64_t last_rank = team == CHESS_WHITE ? RANK_8 : RANK_1;
+    king_safety_t safety;
+    compute_king_safety(game, team, &safety);
+    uint64_t pieces = game->teams[team];
+    if (safety.evasions == 0) {
+        pieces &= game->pieces[CHESS_KING];  // double check
+    }
+    while (pieces) {
+        const chess_value_t index = bit_pop(&pieces);
+        const chess_type_t type = CHESS_TYPE(game->board[index]);
+        uint64_t moves = compute_legal_moves(game, index, &safety);
+        if (type == CHESS_PAWN) {
+            uint64_t promotions = moves & last_rank;
+            moves &= ~last_rank;
+            while (promotions) {
+                const chess_value_t to_index = bit_pop(&promotions);
+                for (int i = CHESS_MOVE_PROMOTE_BISHOP; i <= CHESS_MOVE_PROMOTE_QUEEN; ++i) {
+                    out_moves->moves[out_moves->size++] = CHESS_MOVE(index, to_index, i);
+                }
+            }
+            const uint64_t en_passant = moves & pawn_attacks[team][index] & ~occupied;
+            const uint64_t double_push = moves & (team == CHESS_WHITE ? BIT(index) << 16 : BIT(index) >> 16);
+            add_moves(out_moves, index, en_passant, CHESS_MOVE_EN_PASSANT);
+            add_moves(out_moves, index, double_push, CHESS_MOVE_DOUBLE_PUSH);
+            moves &= ~(en_passant | double_push);
+        }
+        add_moves(out_moves, index, moves, CHESS_MOVE_NORMAL);
+        if (safety.checkers == 0 && type == CHESS_KING) {
+            add_moves(out_moves, index, compute_castling(game, team), CHESS_MOVE_CASTLE);
+        }
+    }
+    return out_moves->size;
+}
+
+bool chess_is_attacked(const chess_game_t* game, chess_index_t index, chess_team_t by_team) {
+    if (game == NULL || index < 0 || index > 63 || by_team < 0 || by_team > 1) {
+        return false;
+    }
+    return is_attacked(game, index, by_team);
+}
+
+uint64_t chess_hash(const chess_game_t* game) {
+    if (game == NULL) {
+        return 0;
+    }
+    return game->hash;
+}
+
+unsigned int chess_halfmove_clock(const chess_game_t* game) {
+    if (game == NULL) {
+        return 0;
+    }
+    return game->halfmove;
+}
+
+size_t chess_repetitions(const chess_game_t* game) {
+    if (game == NULL) {
+        return 0;
+    }
+    size_t result = 0;
+#if CHESS_HISTORY_SIZE
+    // nothing before the last capture or pawn move can come up again, and it takes
+    // at least two moves from each side to get back to a position
+    const size_t plies = game->halfmove < game->history_count ? game->halfmove : game->history_count;
+    for (size_t back = 4; back <= plies; back += 2) {
+        if (game->history[(game->history_top - back) & (CHESS_HISTORY_SIZE - 1)] == game->hash) {
+            ++result;
+        }
+    }
+#endif
+    return result;
+}
@@ -0,0 +1,238 @@
+#include "chess_book.h"
+
+#include <string.h>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define CHESS_BOOK_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CHESS_BOOK_MMAP
+#endif
+#ifndef NULL
+#define NULL 0
+#endif
+
+#define ENTRY_SIZE 16
+// offsets into the Random64 table
+#define RANDOM_CASTLE 768
+#define RANDOM_EN_PASSANT 772
+#define RANDOM_TURN 780
+// the key of the start position, as published with the format
+#define START_KEY 0x463B96181691FC9Cull
+
+// the Polyglot piece kind for each black chess_type_t. White's is one more
+static const int polyglot_kinds[6] = {0, 4, 6, 2, 8, 10};
+// the chess_move_flags_t for each Polyglot promotion, none, knight, bishop, rook, queen
+static const chess_move_flags_t polyglot_promotions[5] = {
+    CHESS_MOVE_NORMAL, CHESS_MOVE_PROMOTE_KNIGHT, CHESS_MOVE_PROMOTE_BISHOP, CHESS_MOVE_PROMOTE_ROOK, CHESS_MOVE_PROMOTE_QUEEN
+};
+
+// the book is stored big endian
+static uint64_t read_big_endian(const uint8_t* data, int size) {
+    uint64_t result = 0;
+    for (int i = 0; i < size; ++i) {
+        result = (result << 8) | data[i];
+    }
+    return result;
+}
+
+// whether random64 is the standard table, going by the key it gives the start position
+static bool is_standard_table(const uint64_t* random64) {
+    chess_book_t book;
+    memset(&book, 0, sizeof(book));
+    book.random64 = random64;
+    chess_game_t game;
+    chess_init(&game);
+    return chess_book_key(&book, &game) == START_KEY;
+}
+
+chess_result_t chess_book_open_memory(chess_book_t* out_book, const void* data, size_t size, const uint64_t* random64) {
+    if (out_book == NULL || data == NULL || random64 == NULL || (size % ENTRY_SIZE) != 0 || !is_standard_table(random64)) {
+        return CHESS_INVALID;
+    }
+    out_book->data = (const uint8_t*)data;
+    out_book->count = size / ENTRY_SIZE;
+    out_book->random64 = random64;
+    out_book->mapping = NULL;
+    out_book->mapping_size = 0;
+    return CHESS_SUCCESS;
+}
+
+chess_result_t chess_book_open(chess_book_t* out_book, const char* path, const uint64_t* random64) {
+    if (out_book == NULL || path == NULL || random64 == NULL || !is_standard_table(random64)) {
+        return CHESS_INVALID;
+    }
+    void* mapping = NULL;
+    size_t size = 0;
+#if defined(CHESS_BOOK_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return CHESS_INVALID;
+    }
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && (unsigned long long)file_size.QuadPart <= (size_t)-1) {
+        size = (size_t)file_size.QuadPart;
+        HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map != NULL) {
+            // the view keeps the file mapped after the handles are closed
+            mapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(file);
+#elif defined(CHESS_BOOK_MMAP)
+    const int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return CHESS_INVALID;
+    }
+    struct stat info;
+    if (0 == fstat(file, &info) && info.st_size > 0) {
+        size = (size_t)info.st_size;
+        mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = NULL;
+        }
+    }
+    // the mapping holds its own reference to the file
+    close(file);
+#else
+    (void)size;
+#endif
+    if (mapping == NULL) {
+        return CHESS_INVALID;
+    }
+    if (CHESS_SUCCESS != chess_book_open_memory(out_book, mapping, size - size % ENTRY_SIZE, random64)) {
+        chess_book_t book;
+        book.mapping = mapping;
+        book.mapping_size = size;
+        chess_book_close(&book);
+        return CHESS_INVALID;
+    }
+    out_book->mapping = mapping;
+    out_book->mapping_size = size;
+    return CHESS_SUCCESS;
+}
+
+void chess_book_close(chess_book_t* book) {
+    if (book == NULL) {
+        return;
+    }
+    if (book->mapping != NULL) {
+#if defined(CHESS_BOOK_WIN32)
+        UnmapViewOfFile(book->mapping);
+#elif defined(CHESS_BOOK_MMAP)
+        munmap(book->mapping, book->mapping_size);
+#endif
+    }
+    book->mapping = NULL;
+    book->mapping_size = 0;
+    book->data = NULL;
+    book->count = 0;
+}
+
+uint64_t chess_book_key(const chess_book_t* book, const chess_game_t* game) {
+    if (book == NULL || game == NULL || book->random64 == NULL) {
+        return 0;
+    }
+    const uint64_t* random64 = book->random64;
+    uint64_t result = 0;
+    for (int index = 0; index < 64; ++index) {
+        const chess_id_t id = game->board[index];
+        if (id != CHESS_NONE) {
+            const int kind = polyglot_kinds[CHESS_TYPE(id)] + (CHESS_TEAM(id) == CHESS_WHITE ? 1 : 0);
+            result ^= random64[64 * kind + index];
+        }
+    }
+    // the castle rights are in the same order as Polyglot's
+    for (int i = 0; i < 4; ++i) {
+        if (game->castle_rights & (1 << i)) {
+            result ^= random64[RANDOM_CASTLE + i];
+        }
+    }
+    // only set when a pawn is there to take, which is what Polyglot wants too
+    if (game->en_passant != CHESS_NONE) {
+        result ^= random64[RANDOM_EN_PASSANT + (game->en_passant & 7)];
+    }
+    if (game->turn == CHESS_WHITE) {
+        result ^= random64[RANDOM_TURN];
+    }
+    return result;
+}
+
+// matches a Polyglot move against the legal moves. Returns false if it isn't one
+static bool find_move(const chess_move_list_t* moves, unsigned int polyglot_move, chess_move_t* out_move) {
+    const chess_index_t to = (chess_index_t)(polyglot_move & 63);
+    const chess_index_t from = (chess_index_t)((polyglot_move >> 6) & 63);
+    const unsigned int promotion = (polyglot_move >> 12) & 7;
+    if (promotion > 4) {
+        return false;
+    }
+    for (size_t i = 0; i < moves->size; ++i) {
+        const chess_move_t move = moves->moves[i];
+        if (CHESS_MOVE_FROM(move) != from) {
+            continue;
+        }
+        const chess_move_flags_t flags = CHESS_MOVE_FLAGS(move);
+        chess_index_t move_to = CHESS_MOVE_TO(move);
+        if (flags == CHESS_MOVE_CASTLE) {
+            // Polyglot castles by moving the king onto its rook
+            move_to = move_to > from ? move_to + 1 : move_to - 2;
+        } else if (flags >= CHESS_MOVE_PROMOTE_BISHOP ? flags != polyglot_promotions[promotion] : promotion != 0) {
+            continue;
+        }
+        if (move_to == to) {
+            *out_move = move;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t chess_book_probe(const chess_book_t* book, const chess_game_t* game, chess_book_entry_t* out_entries, size_t max_entries) {
+    if (book == NULL || game == NULL || book->data == NULL) {
+        return 0;
+    }
+    const uint64_t key = chess_book_key(book, game);
+    // the first entry with the key
+    size_t low = 0;
+    size_t high = book->count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (read_big_endian(book->data + middle * ENTRY_SIZE, 8) < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    chess_move_list_t moves;
+    moves.size = 0;
+    bool generated = false;
+    size_t result = 0;
+    for (size_t i = low; i < book->count; ++i) {
+        const uint8_t* entry = book->data + i * ENTRY_SIZE;
+        if (read_big_endian(entry, 8) != key) {
+            break;
+        }
+        if (!generated) {
+            chess_generate_moves(game, &moves);
+            generated = true;
+        }
+        chess_move_t move;
+        if (!find_move(&moves, (unsigned int)read_big_endian(entry + 8, 2), &move)) {
+            continue;
+        }
+        if (out_entries != NULL && result < max_entries) {
+            out_entries[result].move = move;
+            out_entries[result].weight = (uint16_t)read_big_endian(entry + 10, 2);
+            out_entries[result].learn = (uint32_t)read_big_endian(entry + 12, 4);
+        }
+        ++result;
+    }
+    return result;
+}
@@ -0,0 +1,251 @@
+#include "chess_perft.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chess_thread.h"
+#ifndef NULL
+#define NULL 0
+#endif
+
+// subtrees per thread to aim for, so there's something to steal when one runs long
+#define TASKS_PER_THREAD 32
+// the most subtrees to split into, which bounds the memory used. It has to fit in half a size_t
+#define MAX_TASKS 65535
+// subtrees shallower than this aren't worth splitting further
+#define MIN_TASK_DEPTH 3
+// the most plies the tree is split down, which bounds the path each task keeps
+#define MAX_SPLIT_PLIES 8
+#define CACHE_LINE 64
+// a queue's begin is in the low half of its bounds and its end in the high half
+#define QUEUE_SHIFT (sizeof(size_t) * 4)
+#define QUEUE_MASK (((size_t)1 << QUEUE_SHIFT) - 1)
+
+typedef struct {
+    // the moves from the start to the subtree. The game is only built when the task is run
+    chess_move_t path[MAX_SPLIT_PLIES];
+    int plies;
+    int depth;
+    // the index of the first move on the way here, for divide
+    int root;
+    unsigned long long nodes;
+} perft_task_t;
+
+// a run of tasks. The owner takes from the end and thieves take from the start. Every task is
+// dealt before the workers start, so a run only ever shrinks, and both ends share one word
+// that is updated with a single compare and swap. The padding keeps runs off each other's cache lines
+typedef struct {
+    volatile size_t bounds;
+    char padding[CACHE_LINE - sizeof(size_t)];
+} perft_queue_t;
+
+typedef struct {
+    const chess_game_t* game;
+    perft_task_t* tasks;
+    perft_queue_t* queues;
+    int workers;
+} perft_pool_t;
+
+typedef struct {
+    perft_pool_t* pool;
+    int index;
+} perft_worker_t;
+
+static unsigned long long perft(chess_game_t* game, int depth) {
+    chess_move_list_t moves;
+    chess_generate_moves(game, &moves);
+    if (depth <= 1) {
+        return depth == 1 ? moves.size : 1;
+    }
+    unsigned long long result = 0;
+    for (size_t i = 0; i < moves.size; ++i) {
+        chess_undo_t undo;
+        chess_make_move(game, moves.moves[i], &undo);
+        result += perft(game, depth - 1);
+        chess_unmake_move(game, &undo);
+    }
+    return result;
+}
+
+// plays a task's path from the start position
+static void task_game(const chess_game_t* game, const perft_task_t* task, chess_game_t* out_game) {
+    *out_game = *game;
+    for (int i = 0; i < task->plies; ++i) {
+        chess_make_move(out_game, task->path[i], NULL);
+    }
+}
+
+static bool take_task(perft_queue_t* queue, bool own, size_t* out_index) {
+    while (true) {
+        const size_t bounds = chess_atomic_load(&queue->bounds);
+        const size_t begin = bounds & QUEUE_MASK;
+        const size_t end = bounds >> QUEUE_SHIFT;
+        if (begin >= end) {
+            return false;
+        }
+        // the bounds only ever close in, so the same word can't come back around
+        const size_t next = own ? begin | ((end - 1) << QUEUE_SHIFT) : (begin + 1) | (end << QUEUE_SHIFT);
+        if (chess_atomic_compare_exchange(&queue->bounds, bounds, next)) {
+            *out_index = own ? end - 1 : begin;
+            return true;
+        }
+    }
+}
+
+static void worker(void* state) {
+    const perft_worker_t* self = (const perft_worker_t*)state;
+    perft_pool_t* pool = self->pool;
+    while (true) {
+        size_t index;
+        bool found = take_task(&pool->queues[self->index], true, &index);
+        // steal from the others, starting with the next one along
+        for (int i = 1; !found && i < pool->workers; ++i) {
+            found = take_task(&pool->queues[(self->index + i) % pool->workers], false, &index);
+        }
+        if (!found) {
+            return;
+        }
+        // each task has its own count, so nothing is shared here
+        perft_task_t* task = &pool->tasks[index];
+        chess_game_t game;
+        task_game(pool->game, task, &game);
+        task->nodes = perft(&game, task->depth);
+    }
+}
+
+// replaces each task with one for each of its moves. Returns NULL if there'd be too many
+static perft_task_t* split_tasks(const chess_game_t* start, perft_task_t* tasks, size_t* count) {
+    size_t new_count = 0;
+    for (size_t i = 0; i < *count; ++i) {
+        chess_game_t game;
+        task_game(start, &tasks[i], &game);
+        chess_move_list_t moves;
+        new_count += chess_generate_moves(&game, &moves);
+    }
+    if (new_count > MAX_TASKS) {
+        return NULL;
+    }
+    perft_task_t* result = (perft_task_t*)malloc((new_count > 0 ? new_count : 1) * sizeof(perft_task_t));
+    if (result == NULL) {
+        return NULL;
+    }
+    size_t index = 0;
+    for (size_t i = 0; i < *count; ++i) {
+        chess_game_t game;
+        task_game(start, &tasks[i], &game);
+        chess_move_list_t moves;
+        chess_generate_moves(&game, &moves);
+        for (size_t j = 0; j < moves.size; ++j) {
+            perft_task_t* task = &result[index++];
+            *task = tasks[i];
+            task->path[task->plies++] = moves.moves[j];
+            task->depth = tasks[i].depth - 1;
+            task->root = tasks[i].root < 0 ? (int)j : tasks[i].root;
+            task->nodes = 0;
+        }
+    }
+    *count = new_count;
+    return result;
+}
+
+static void run_tasks(const chess_game_t* game, perft_task_t* tasks, size_t count, int threads) {
+    perft_pool_t pool;
+    pool.game = game;
+    pool.tasks = tasks;
+    pool.workers = threads;
+    pool.queues = (perft_queue_t*)malloc((size_t)threads * sizeof(perft_queue_t));
+    perft_worker_t* workers = (perft_worker_t*)malloc((size_t)threads * sizeof(perft_worker_t));
+    chess_thread_t* handles = (chess_thread_t*)malloc((size_t)threads * sizeof(chess_thread_t));
+    if (pool.queues == NULL || workers == NULL || handles == NULL) {
+        pool.workers = 0;
+    }
+    // deal the tasks out in even runs
+    for (int i = 0; i < pool.workers; ++i) {
+        const size_t begin = count * (size_t)i / (size_t)threads;
+        const size_t end = count * (size_t)(i + 1) / (size_t)threads;
+        pool.queues[i].bounds = begin | (end << QUEUE_SHIFT);
+        workers[i].pool = &pool;
+        workers[i].index = i;
+    }
+    // the calling thread is worker 0
+    int started = 1;
+    while (started < pool.workers && chess_thread_start(&handles[started], worker, &workers[started])) {
+        ++started;
+    }
+    if (pool.workers > 0) {
+        worker(&workers[0]);
+    }
+    for (int i = 1; i < started; ++i) {
+        chess_thread_join(handles[i]);
+    }
+    if (pool.workers == 0) {
+        for (size_t i = 0; i < count; ++i) {
+            chess_game_t task_start;
+            task_game(game, &tasks[i], &task_start);
+            tasks[i].nodes = perft(&task_start, tasks[i].depth);
+        }
+    }
+    free(handles);
+    free(workers);
+    free(pool.queues);
+}
+
+// walks the tree from game, splitting it at least once if divide is set. Fills in the counts per root move if given
+static unsigned long long walk(const chess_game_t* game, int depth, int threads, bool divide, unsigned long long* out_counts) {
+    if (threads == 0) {
+        threads = chess_thread_hardware_count();
+    }
+#ifdef CHESS_NO_THREADS
+    threads = 1;
+#endif
+    perft_task_t* tasks = (perft_task_t*)malloc(sizeof(perft_task_t));
+    if (tasks == NULL) {
+        chess_game_t copy = *game;
+        return divide ? 0 : perft(&copy, depth);
+    }
+    tasks->plies = 0;
+    tasks->depth = depth;
+    tasks->root = -1;
+    tasks->nodes = 0;
+    size_t count = 1;
+    while (count > 0 && tasks[0].depth > 0 && tasks[0].plies < MAX_SPLIT_PLIES && ((divide && tasks[0].root < 0) ||
+           (threads > 1 && count < (size_t)threads * TASKS_PER_THREAD && tasks[0].depth > MIN_TASK_DEPTH))) {
+        perft_task_t* split = split_tasks(game, tasks, &count);
+        if (split == NULL) {
+            break;
+        }
+        free(tasks);
+        tasks = split;
+    }
+    if (divide && count > 0 && tasks[0].root < 0) {
+        // couldn't split at the root
+        free(tasks);
+        return 0;
+    }
+    run_tasks(game, tasks, count, threads);
+    unsigned long long result = 0;
+    for (size_t i = 0; i < count; ++i) {
+        result += tasks[i].nodes;
+        if (out_counts != NULL) {
+            out_counts[tasks[i].root] += tasks[i].nodes;
+        }
+    }
+    free(tasks);
+    return result;
+}
+
+unsigned long long chess_perft(const chess_game_t* game, int depth, int threads) {
+    if (game == NULL || depth < 0 || threads < 0) {
+        return 0;
+    }
+    return walk(game, depth, threads, false, NULL);
+}
+
+unsigned long long chess_perft_divide(const chess_game_t* game, int depth, int threads, chess_move_list_t* out_moves, unsigned long long* out_counts) {
+    if (game == NULL || depth < 1 || threads < 0 || out_moves == NULL || out_counts == NULL) {
+        return 0;
+    }
+    chess_generate_moves(game, out_moves);
+    memset(out_counts, 0, out_moves->size * sizeof(unsigned long long));
+    return walk(game, depth, threads, true, out_counts);
+}
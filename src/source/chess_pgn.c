@@ -0,0 +1,515 @@
+#include "chess_pgn.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chess_thread.h"
+#ifndef NULL
+#define NULL 0
+#endif
+
+// the size of each read from the input
+#define CHUNK_SIZE (64 * 1024)
+// slots per worker, so the reader can run ahead while the workers are busy
+#define SLOTS_PER_THREAD 4
+
+static bool is_space(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\f' || ch == '\v';
+}
+
+static bool is_file(char ch) {
+    return ch >= 'a' && ch <= 'h';
+}
+
+static bool is_rank(char ch) {
+    return ch >= '1' && ch <= '8';
+}
+
+static chess_value_t piece_type(char ch) {
+    switch (ch) {
+        case 'B': return CHESS_BISHOP;
+        case 'R': return CHESS_ROOK;
+        case 'N': return CHESS_KNIGHT;
+        case 'Q': return CHESS_QUEEN;
+        case 'K': return CHESS_KING;
+        default: return CHESS_NONE;
+    }
+}
+
+// finds the castle toward the h file, or the a file
+static bool castle_to_move(const chess_move_list_t* moves, bool queen_side, chess_move_t* out_move) {
+    for (size_t i = 0; i < moves->size; ++i) {
+        const chess_move_t move = moves->moves[i];
+        if (CHESS_MOVE_FLAGS(move) != CHESS_MOVE_CASTLE) {
+            continue;
+        }
+        if ((CHESS_MOVE_TO(move) < CHESS_MOVE_FROM(move)) == queen_side) {
+            *out_move = move;
+            return true;
+        }
+    }
+    return false;
+}
+
+// finds the one legal move matching a move in standard algebraic notation, with any check or annotation marks removed
+static bool san_to_move(const chess_game_t* game, const char* san, size_t length, chess_move_t* out_move) {
+    chess_move_list_t moves;
+    chess_generate_moves(game, &moves);
+    if ((length == 3 && (0 == memcmp(san, "O-O", 3) || 0 == memcmp(san, "0-0", 3))) ||
+        (length == 5 && (0 == memcmp(san, "O-O-O", 5) || 0 == memcmp(san, "0-0-0", 5)))) {
+        return castle_to_move(&moves, length == 5, out_move);
+    }
+    chess_value_t type = CHESS_PAWN;
+    if (length > 0 && piece_type(san[0]) != CHESS_NONE) {
+        type = piece_type(san[0]);
+        ++san;
+        --length;
+    }
+    chess_value_t promotion = CHESS_NONE;
+    if (type == CHESS_PAWN && length > 2) {
+        char ch = san[length - 1];
+        if (ch >= 'a' && ch <= 'z' && san[length - 2] == '=') {
+            ch = (char)(ch - 'a' + 'A');
+        }
+        if (piece_type(ch) != CHESS_NONE && piece_type(ch) != CHESS_KING) {
+            promotion = piece_type(ch);
+            length -= san[length - 2] == '=' ? 2 : 1;
+        }
+    }
+    if (length < 2 || !is_file(san[length - 2]) || !is_rank(san[length - 1])) {
+        return false;
+    }
+    const chess_index_t to = (chess_index_t)((san[length - 1] - '1') * 8 + (san[length - 2] - 'a'));
+    chess_value_t from_file = CHESS_NONE;
+    chess_value_t from_rank = CHESS_NONE;
+    for (size_t i = 0; i < length - 2; ++i) {
+        if (is_file(san[i])) {
+            from_file = san[i] - 'a';
+        } else if (is_rank(san[i])) {
+            from_rank = san[i] - '1';
+        } else if (san[i] != 'x' && san[i] != '-') {
+            return false;
+        }
+    }
+    size_t found = 0;
+    for (size_t i = 0; i < moves.size; ++i) {
+        const chess_move_t move = moves.moves[i];
+        const chess_index_t from = CHESS_MOVE_FROM(move);
+        if (CHESS_MOVE_TO(move) != to || CHESS_MOVE_FLAGS(move) == CHESS_MOVE_CASTLE ||
+            (chess_value_t)CHESS_TYPE(chess_index_to_id(game, from)) != type || CHESS_MOVE_PROMOTION(move) != promotion ||
+            (from_file != CHESS_NONE && from % 8 != from_file) || (from_rank != CHESS_NONE && from / 8 != from_rank)) {
+            continue;
+        }
+        *out_move = move;
+        ++found;
+    }
+    return found == 1;
+}
+
+// reads a tag like [FEN "..."] and sets up the game if it's a FEN tag
+static bool parse_tag(chess_game_t* game, const char* text, size_t size, size_t* position, chess_pgn_verdict_t* out_verdict) {
+    size_t i = *position + 1;
+    const size_t name_start = i;
+    while (i < size && !is_space(text[i]) && text[i] != '"' && text[i] != ']') {
+        ++i;
+    }
+    const bool is_fen = i - name_start == 3 && 0 == memcmp(text + name_start, "FEN", 3);
+    while (i < size && is_space(text[i])) {
+        ++i;
+    }
+    if (i >= size || text[i] != '"') {
+        *out_verdict = CHESS_PGN_BAD_SYNTAX;
+        return false;
+    }
+    ++i;
+    char value[CHESS_MAX_FEN];
+    size_t value_size = 0;
+    while (i < size && text[i] != '"') {
+        if (text[i] == '\\' && i + 1 < size) {
+            ++i;
+        }
+        if (value_size < sizeof(value) - 1) {
+            value[value_size++] = text[i];
+        }
+        ++i;
+    }
+    value[value_size] = '\0';
+    while (i < size && text[i] != ']') {
+        ++i;
+    }
+    if (i >= size) {
+        *out_verdict = CHESS_PGN_BAD_SYNTAX;
+        return false;
+    }
+    *position = i + 1;
+    if (is_fen && CHESS_SUCCESS != chess_from_fen(game, value)) {
+        *out_verdict = CHESS_PGN_BAD_FEN;
+        return false;
+    }
+    return true;
+}
+
+// skips a brace comment, a rest of line comment or a variation
+static bool skip_comment(const char* text, size_t size, size_t* position) {
+    size_t i = *position;
+    if (text[i] == '{') {
+        while (i < size && text[i] != '}') {
+            ++i;
+        }
+        if (i >= size) {
+            return false;
+        }
+        *position = i + 1;
+        return true;
+    }
+    if (text[i] == ';' || text[i] == '%') {
+        while (i < size && text[i] != '\n') {
+            ++i;
+        }
+        *position = i;
+        return true;
+    }
+    // a variation, which may hold comments and other variations
+    int depth = 0;
+    while (i < size) {
+        if (text[i] == '{' || text[i] == ';') {
+            if (!skip_comment(text, size, &i)) {
+                return false;
+            }
+            continue;
+        }
+        if (text[i] == '(') {
+            ++depth;
+        } else if (text[i] == ')' && --depth == 0) {
+            *position = i + 1;
+            return true;
+        }
+        ++i;
+    }
+    return false;
+}
+
+static bool is_token_end(char ch) {
+    return is_space(ch) || ch == '{' || ch == '(' || ch == ')' || ch == ';';
+}
+
+chess_result_t chess_pgn_validate_game(const char* text, size_t size, chess_pgn_game_result_t* out_result) {
+    if (text == NULL || out_result == NULL) {
+        return CHESS_INVALID;
+    }
+    out_result->index = 0;
+    out_result->offset = 0;
+    out_result->plies = 0;
+    out_result->verdict = CHESS_PGN_VALID;
+    chess_game_t game;
+    chess_init(&game);
+    bool in_movetext = false;
+    size_t i = 0;
+    while (i < size) {
+        const char ch = text[i];
+        if (is_space(ch)) {
+            ++i;
+            continue;
+        }
+        if (ch == '[' && !in_movetext) {
+            if (!parse_tag(&game, text, size, &i, &out_result->verdict)) {
+                return CHESS_SUCCESS;
+            }
+            continue;
+        }
+        in_movetext = true;
+        if (ch == '{' || ch == ';' || ch == '(' || (ch == '%' && (i == 0 || text[i - 1] == '\n'))) {
+            if (!skip_comment(text, size, &i)) {
+                out_result->verdict = CHESS_PGN_BAD_SYNTAX;
+                return CHESS_SUCCESS;
+            }
+            continue;
+        }
+        size_t start = i;
+        while (i < size && !is_token_end(text[i])) {
+            ++i;
+        }
+        size_t length = i - start;
+        const char* token = text + start;
+        if (length == 0) {
+            // a stray closing parenthesis
+            out_result->verdict = CHESS_PGN_BAD_SYNTAX;
+            return CHESS_SUCCESS;
+        }
+        if (token[0] == '$') {
+            continue;
+        }
+        if ((length == 3 && (0 == memcmp(token, "1-0", 3) || 0 == memcmp(token, "0-1", 3))) ||
+            (length == 7 && 0 == memcmp(token, "1/2-1/2", 7)) || (length == 1 && token[0] == '*')) {
+            // the game termination marker ends the movetext
+            return CHESS_SUCCESS;
+        }
+        // a move number, possibly run together with the move, as in 12.e4
+        size_t digits = 0;
+        while (digits < length && token[digits] >= '0' && token[digits] <= '9') {
+            ++digits;
+        }
+        if (digits > 0 && digits < length && token[digits] == '.') {
+            while (digits < length && token[digits] == '.') {
+                ++digits;
+            }
+            token += digits;
+            length -= digits;
+            if (length == 0) {
+                continue;
+            }
+        }
+        while (length > 0 && (token[length - 1] == '+' || token[length - 1] == '#' || token[length - 1] == '!' || token[length - 1] == '?')) {
+            --length;
+        }
+        chess_move_t move;
+        if (!san_to_move(&game, token, length, &move)) {
+            out_result->verdict = CHESS_PGN_ILLEGAL_MOVE;
+            return CHESS_SUCCESS;
+        }
+        chess_make_move(&game, move, NULL);
+        ++out_result->plies;
+    }
+    return CHESS_SUCCESS;
+}
+
+enum {
+    SLOT_FREE = 0,
+    SLOT_QUEUED,
+    SLOT_DONE
+};
+
+typedef struct {
+    char* text;
+    size_t size;
+    bool too_long;
+    int state;
+    chess_pgn_game_result_t result;
+} pgn_slot_t;
+
+typedef struct {
+    pgn_slot_t* slots;
+    size_t slot_count;
+    // games handed to the workers are [next_job, queued)
+    size_t next_job;
+    size_t queued;
+    // games before this have been reported
+    size_t reported;
+    bool finished;
+    int workers;
+    chess_mutex_t mutex;
+    chess_cond_t work;
+    chess_cond_t done;
+    chess_pgn_callback_t callback;
+    void* callback_state;
+    chess_pgn_stats_t stats;
+} pgn_pool_t;
+
+static void validate_slot(pgn_slot_t* slot) {
+    const size_t index = slot->result.index;
+    const unsigned long long offset = slot->result.offset;
+    if (slot->too_long) {
+        slot->result.verdict = CHESS_PGN_TOO_LONG;
+        slot->result.plies = 0;
+    } else {
+        chess_pgn_validate_game(slot->text, slot->size, &slot->result);
+    }
+    slot->result.index = index;
+    slot->result.offset = offset;
+}
+
+static void worker(void* state) {
+    pgn_pool_t* pool = (pgn_pool_t*)state;
+    chess_mutex_lock(&pool->mutex);
+    while (true) {
+        while (pool->next_job == pool->queued && !pool->finished) {
+            chess_cond_wait(&pool->work, &pool->mutex);
+        }
+        if (pool->next_job == pool->queued) {
+            break;
+        }
+        pgn_slot_t* slot = &pool->slots[pool->next_job++ % pool->slot_count];
+        chess_mutex_unlock(&pool->mutex);
+        validate_slot(slot);
+        chess_mutex_lock(&pool->mutex);
+        slot->state = SLOT_DONE;
+        chess_cond_broadcast(&pool->done);
+    }
+    chess_mutex_unlock(&pool->mutex);
+}
+
+// waits for the oldest game in flight and reports it
+static void report_next(pgn_pool_t* pool) {
+    pgn_slot_t* slot = &pool->slots[pool->reported % pool->slot_count];
+    if (pool->workers > 0) {
+        chess_mutex_lock(&pool->mutex);
+        while (slot->state != SLOT_DONE) {
+            chess_cond_wait(&pool->done, &pool->mutex);
+        }
+        chess_mutex_unlock(&pool->mutex);
+    }
+    ++pool->stats.games;
+    pool->stats.plies += slot->result.plies;
+    if (slot->result.verdict == CHESS_PGN_VALID) {
+        ++pool->stats.valid;
+    }
+    if (pool->callback != NULL) {
+        pool->callback(&slot->result, pool->callback_state);
+    }
+    slot->state = SLOT_FREE;
+    ++pool->reported;
+}
+
+// gets the slot for the next game, reporting the game that had it if need be
+static pgn_slot_t* begin_game(pgn_pool_t* pool, size_t index, unsigned long long offset) {
+    if (index - pool->reported == pool->slot_count) {
+        report_next(pool);
+    }
+    pgn_slot_t* slot = &pool->slots[index % pool->slot_count];
+    slot->size = 0;
+    slot->too_long = false;
+    slot->result.index = index;
+    slot->result.offset = offset;
+    return slot;
+}
+
+static void queue_game(pgn_pool_t* pool, pgn_slot_t* slot) {
+    if (pool->workers == 0) {
+        validate_slot(slot);
+        slot->state = SLOT_DONE;
+        report_next(pool);
+        return;
+    }
+    chess_mutex_lock(&pool->mutex);
+    slot->state = SLOT_QUEUED;
+    ++pool->queued;
+    chess_cond_broadcast(&pool->work);
+    chess_mutex_unlock(&pool->mutex);
+}
+
+chess_result_t chess_pgn_validate(chess_pgn_read_t read, void* read_state, int threads, chess_pgn_callback_t callback, void* callback_state, chess_pgn_stats_t* out_stats) {
+    if (read == NULL || threads < 0) {
+        return CHESS_INVALID;
+    }
+    if (threads == 0) {
+        threads = chess_thread_hardware_count();
+    }
+#ifdef CHESS_NO_THREADS
+    threads = 0;
+#endif
+    pgn_pool_t pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.callback = callback;
+    pool.callback_state = callback_state;
+    pool.slot_count = threads > 0 ? (size_t)threads * SLOTS_PER_THREAD : 1;
+    pool.slots = (pgn_slot_t*)calloc(pool.slot_count, sizeof(pgn_slot_t));
+    char* chunk = (char*)malloc(CHUNK_SIZE);
+    bool out_of_memory = pool.slots == NULL || chunk == NULL;
+    for (size_t i = 0; !out_of_memory && i < pool.slot_count; ++i) {
+        pool.slots[i].text = (char*)malloc(CHESS_PGN_MAX_GAME);
+        out_of_memory = pool.slots[i].text == NULL;
+    }
+    chess_thread_t* handles = NULL;
+    if (!out_of_memory && threads > 0) {
+        handles = (chess_thread_t*)malloc((size_t)threads * sizeof(chess_thread_t));
+        out_of_memory = handles == NULL;
+    }
+    if (out_of_memory) {
+        for (size_t i = 0; pool.slots != NULL && i < pool.slot_count; ++i) {
+            free(pool.slots[i].text);
+        }
+        free(pool.slots);
+        free(chunk);
+        return CHESS_OUT_OF_MEMORY;
+    }
+    chess_mutex_init(&pool.mutex);
+    chess_cond_init(&pool.work);
+    chess_cond_init(&pool.done);
+    // chess_init() fills the shared tables on first use, so do that here
+    // before any worker can race to it
+    chess_game_t scratch;
+    chess_init(&scratch);
+    for (int i = 0; i < threads; ++i) {
+        if (!chess_thread_start(&handles[pool.workers], worker, &pool)) {
+            break;
+        }
+        ++pool.workers;
+    }
+
+    // split the stream into games. A tag line after some movetext starts a new game
+    pgn_slot_t* slot = NULL;
+    size_t games = 0;
+    bool has_movetext = false;
+    bool line_start = true;
+    bool in_comment = false;
+    bool in_line_comment = false;
+    size_t read_size;
+    while ((read_size = read(chunk, CHUNK_SIZE, read_state)) > 0) {
+        for (size_t i = 0; i < read_size; ++i) {
+            const char ch = chunk[i];
+            const unsigned long long offset = pool.stats.bytes + i;
+            if (line_start && !is_space(ch) && !in_comment) {
+                line_start = false;
+                if (ch == '[' && has_movetext && slot != NULL) {
+                    queue_game(&pool, slot);
+                    slot = NULL;
+                    has_movetext = false;
+                } else if (ch != '[' && ch != '%') {
+                    has_movetext = true;
+                }
+            }
+            if (slot == NULL) {
+                if (is_space(ch)) {
+                    continue;
+                }
+                slot = begin_game(&pool, games++, offset);
+            }
+            if (slot->size < CHESS_PGN_MAX_GAME) {
+                slot->text[slot->size++] = ch;
+            } else {
+                slot->too_long = true;
+            }
+            if (in_comment) {
+                in_comment = ch != '}';
+            } else if (in_line_comment) {
+                in_line_comment = ch != '\n';
+            } else if (ch == '{') {
+                in_comment = true;
+            } else if (ch == ';') {
+                in_line_comment = true;
+            }
+            if (ch == '\n') {
+                line_start = true;
+                in_line_comment = false;
+            }
+        }
+        pool.stats.bytes += read_size;
+    }
+    if (slot != NULL) {
+        queue_game(&pool, slot);
+    }
+
+    chess_mutex_lock(&pool.mutex);
+    pool.finished = true;
+    chess_cond_broadcast(&pool.work);
+    chess_mutex_unlock(&pool.mutex);
+    while (pool.reported < games) {
+        report_next(&pool);
+    }
+    for (int i = 0; i < pool.workers; ++i) {
+        chess_thread_join(handles[i]);
+    }
+    chess_cond_destroy(&pool.done);
+    chess_cond_destroy(&pool.work);
+    chess_mutex_destroy(&pool.mutex);
+    for (size_t i = 0; i < pool.slot_count; ++i) {
+        free(pool.slots[i].text);
+    }
+    free(pool.slots);
+    free(handles);
+    free(chunk);
+    if (out_stats != NULL) {
+        *out_stats = pool.stats;
+    }
+    return CHESS_SUCCESS;
+}
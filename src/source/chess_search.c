@@ -0,0 +1,306 @@
+#include "chess_search.h"
+
+#include <string.h>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#ifndef NULL
+#define NULL 0
+#endif
+
+// scores beyond this are mates, counted in plies from the root
+#define MATE_BOUND (CHESS_SEARCH_MATE - CHESS_SEARCH_MAX_DEPTH)
+// how many positions to visit between looks at the clock
+#define CLOCK_INTERVAL 1024
+
+typedef struct {
+    chess_game_t game;
+    chess_tt_t* tt;
+    // hundredths of a pawn for each piece type
+    int values[6];
+    unsigned long long nodes;
+    unsigned long long node_limit;
+    unsigned long long deadline;
+    bool stopped;
+    // quiet moves that caused a cutoff at each ply, tried early in sibling positions
+    chess_move_t killers[CHESS_SEARCH_MAX_DEPTH][2];
+} search_t;
+
+// a millisecond clock for the time limit
+static unsigned long long now_milliseconds(void) {
+#if defined(_WIN32)
+    return (unsigned long long)GetTickCount64();
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000 + (unsigned long long)ts.tv_nsec / 1000000;
+#else
+    return (unsigned long long)clock() * 1000 / CLOCKS_PER_SEC;
+#endif
+}
+
+static bool check_limits(search_t* search) {
+    if (!search->stopped) {
+        if (search->node_limit != 0 && search->nodes >= search->node_limit) {
+            search->stopped = true;
+        } else if (search->deadline != 0 && (search->nodes % CLOCK_INTERVAL) == 0 && now_milliseconds() >= search->deadline) {
+            search->stopped = true;
+        }
+    }
+    return search->stopped;
+}
+
+// the evaluation for the team that is up, which the game keeps as moves are made
+static int evaluate(const search_t* search) {
+    return chess_evaluate(&search->game);
+}
+
+static bool is_capture(const chess_game_t* game, chess_move_t move) {
+    return game->board[CHESS_MOVE_TO(move)] != CHESS_NONE || CHESS_MOVE_FLAGS(move) == CHESS_MOVE_EN_PASSANT;
+}
+
+static bool in_check(const chess_game_t* game) {
+    return chess_is_attacked(game, game->kings[game->turn], (chess_team_t)(1 - game->turn));
+}
+
+// ranks the moves so the likeliest to cause a cutoff go first: the stored best
+// move, then captures of big pieces by small ones, promotions, and killers
+static void score_moves(const search_t* search, const chess_move_list_t* moves, chess_move_t best, int ply, int* out_scores) {
+    const chess_game_t* game = &search->game;
+    for (size_t i = 0; i < moves->size; ++i) {
+        const chess_move_t move = moves->moves[i];
+        int score = 0;
+        if (move == best) {
+            score = 1 << 30;
+        } else if (is_capture(game, move)) {
+            const chess_id_t victim = game->board[CHESS_MOVE_TO(move)];
+            const int victim_value = victim == CHESS_NONE ? search->values[CHESS_PAWN] : search->values[CHESS_TYPE(victim)];
+            score = (1 << 24) + victim_value * 16 - search->values[CHESS_TYPE(game->board[CHESS_MOVE_FROM(move)])] / 100;
+        } else if (CHESS_MOVE_FLAGS(move) == CHESS_MOVE_PROMOTE_QUEEN) {
+            score = 1 << 23;
+        } else if (ply < CHESS_SEARCH_MAX_DEPTH && (move == search->killers[ply][0] || move == search->killers[ply][1])) {
+            score = move == search->killers[ply][0] ? (1 << 22) + 1 : 1 << 22;
+        }
+        out_scores[i] = score;
+    }
+}
+
+// swaps the best scoring move from index on into index, so the list is only sorted as far as it's used
+static chess_move_t pick_move(chess_move_list_t* moves, int* scores, size_t index) {
+    size_t best = index;
+    for (size_t i = index + 1; i < moves->size; ++i) {
+        if (scores[i] > scores[best]) {
+            best = i;
+        }
+    }
+    const chess_move_t move = moves->moves[best];
+    const int score = scores[best];
+    moves->moves[best] = moves->moves[index];
+    scores[best] = scores[index];
+    moves->moves[index] = move;
+    scores[index] = score;
+    return move;
+}
+
+// mate scores are stored relative to the position rather than the root
+static int score_to_tt(int score, int ply) {
+    return score > MATE_BOUND ? score + ply : score < -MATE_BOUND ? score - ply : score;
+}
+
+static int score_from_tt(int score, int ply) {
+    return score > MATE_BOUND ? score - ply : score < -MATE_BOUND ? score + ply : score;
+}
+
+// searches captures and queen promotions until the position is quiet
+static int quiesce(search_t* search, int alpha, int beta, int ply) {
+    ++search->nodes;
+    if (check_limits(search)) {
+        return 0;
+    }
+    chess_move_list_t moves;
+    if (0 == chess_generate_moves(&search->game, &moves)) {
+        return in_check(&search->game) ? -CHESS_SEARCH_MATE + ply : 0;
+    }
+    int best = evaluate(search);
+    if (best >= beta || ply >= CHESS_SEARCH_MAX_DEPTH) {
+        return best;
+    }
+    if (best > alpha) {
+        alpha = best;
+    }
+    int scores[CHESS_MAX_MOVES];
+    score_moves(search, &moves, 0, CHESS_SEARCH_MAX_DEPTH, scores);
+    for (size_t i = 0; i < moves.size; ++i) {
+        const chess_move_t move = pick_move(&moves, scores, i);
+        if (scores[i] < (1 << 23)) {
+            break;  // only quiet moves are left
+        }
+        chess_undo_t undo;
+        chess_make_move(&search->game, move, &undo);
+        const int score = -quiesce(search, -beta, -alpha, ply + 1);
+        chess_unmake_move(&search->game, &undo);
+        if (search->stopped) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            if (score > alpha) {
+                alpha = score;
+                if (score >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+static int negamax(search_t* search, int depth, int alpha, int beta, int ply) {
+    const bool checked = in_check(&search->game);
+    if (checked && ply < CHESS_SEARCH_MAX_DEPTH / 2) {
+        ++depth;  // look further when in check, so a mate isn't pushed past the horizon
+    }
+    if (depth <= 0 || ply >= CHESS_SEARCH_MAX_DEPTH) {
+        return quiesce(search, alpha, beta, ply);
+    }
+    ++search->nodes;
+    if (check_limits(search)) {
+        return 0;
+    }
+    // a position that came up before can be steered into again, so it scores as a draw, as does the fifty move rule
+    if (ply > 0 && (chess_halfmove_clock(&search->game) >= 100 || chess_repetitions(&search->game) > 0)) {
+        return 0;
+    }
+    const uint64_t key = chess_hash(&search->game);
+    chess_move_t best_move = 0;
+    if (search->tt != NULL) {
+        chess_tt_entry_t entry;
+        if (chess_tt_probe(search->tt, key, &entry)) {
+            best_move = entry.move;
+            const int score = score_from_tt(entry.value, ply);
+            if (entry.depth >= depth && ply > 0 &&
+                (entry.bound == CHESS_TT_EXACT ||
+                 (entry.bound == CHESS_TT_LOWER && score >= beta) ||
+                 (entry.bound == CHESS_TT_UPPER && score <= alpha))) {
+                return score;
+            }
+        }
+    }
+    chess_move_list_t moves;
+    if (0 == chess_generate_moves(&search->game, &moves)) {
+        return checked ? -CHESS_SEARCH_MATE + ply : 0;
+    }
+    int scores[CHESS_MAX_MOVES];
+    score_moves(search, &moves, best_move, ply, scores);
+    const int alpha_start = alpha;
+    int best = -CHESS_SEARCH_MATE - 1;
+    for (size_t i = 0; i < moves.size; ++i) {
+        const chess_move_t move = pick_move(&moves, scores, i);
+        const bool quiet = !is_capture(&search->game, move);
+        chess_undo_t undo;
+        chess_make_move(&search->game, move, &undo);
+        const int score = -negamax(search, depth - 1, -beta, -alpha, ply + 1);
+        chess_unmake_move(&search->game, &undo);
+        if (search->stopped) {
+            return 0;
+        }
+        if (score > best) {
+            best = score;
+            best_move = move;
+            if (score > alpha) {
+                alpha = score;
+                if (score >= beta) {
+                    if (quiet && search->killers[ply][0] != move) {
+                        search->killers[ply][1] = search->killers[ply][0];
+                        search->killers[ply][0] = move;
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    if (search->tt != NULL) {
+        chess_tt_entry_t entry;
+        entry.value = score_to_tt(best, ply);
+        entry.move = best_move;
+        entry.depth = (uint8_t)depth;
+        entry.bound = best >= beta ? CHESS_TT_LOWER : best > alpha_start ? CHESS_TT_EXACT : CHESS_TT_UPPER;
+        chess_tt_store(search->tt, key, &entry);
+    }
+    return best;
+}
+
+// searches every move at the root to depth, best first. Returns false if the limits ran out first
+static bool search_root(search_t* search, chess_move_list_t* moves, int depth, chess_search_result_t* out_best) {
+    int alpha = -CHESS_SEARCH_MATE - 1;
+    chess_move_t best_move = moves->moves[0];
+    size_t best_index = 0;
+    for (size_t i = 0; i < moves->size; ++i) {
+        chess_undo_t undo;
+        chess_make_move(&search->game, moves->moves[i], &undo);
+        const int score = -negamax(search, depth - 1, -CHESS_SEARCH_MATE - 1, -alpha, 1);
+        chess_unmake_move(&search->game, &undo);
+        if (search->stopped) {
+            return false;
+        }
+        if (score > alpha) {
+            alpha = score;
+            best_move = moves->moves[i];
+            best_index = i;
+        }
+    }
+    // the best move goes first next time around
+    moves->moves[best_index] = moves->moves[0];
+    moves->moves[0] = best_move;
+    out_best->move = best_move;
+    out_best->score = alpha;
+    out_best->depth = depth;
+    return true;
+}
+
+chess_result_t chess_search(const chess_game_t* game, const chess_search_limits_t* limits, chess_search_result_t* out_best) {
+    if (game == NULL || limits == NULL || out_best == NULL || limits->depth < 0 ||
+        (limits->depth == 0 && limits->nodes == 0 && limits->milliseconds == 0)) {
+        return CHESS_INVALID;
+    }
+    search_t search;
+    memset(&search, 0, sizeof(search));
+    search.game = *game;
+    search.tt = limits->tt;
+    // the limits are only armed once the first ply is done, so there's always a move
+    const unsigned long long deadline = limits->milliseconds != 0 ? now_milliseconds() + limits->milliseconds : 0;
+    for (int type = CHESS_PAWN; type < CHESS_KING; ++type) {
+        search.values[type] = (int)chess_type_score((chess_type_t)type) * 100;
+    }
+    chess_move_list_t moves;
+    if (0 == chess_generate_moves(&search.game, &moves)) {
+        return CHESS_INVALID;
+    }
+    if (search.tt != NULL) {
+        chess_tt_new_search(search.tt);
+    }
+    const int depth_limit = limits->depth == 0 || limits->depth > CHESS_SEARCH_MAX_DEPTH ? CHESS_SEARCH_MAX_DEPTH : limits->depth;
+    chess_search_result_t result;
+    for (int depth = 1; depth <= depth_limit; ++depth) {
+        if (!search_root(&search, &moves, depth, &result)) {
+            break;
+        }
+        *out_best = result;
+        if (depth == 1) {
+            search.node_limit = limits->nodes;
+            search.deadline = deadline;
+            check_limits(&search);
+        }
+        // a forced mate won't get any shorter
+        if (search.stopped || result.score > MATE_BOUND || result.score < -MATE_BOUND) {
+            break;
+        }
+    }
+    out_best->nodes = search.nodes;
+    return CHESS_SUCCESS;
+}
@@ -0,0 +1,398 @@
+#include "chess_session.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chess_thread.h"
+#ifndef NULL
+#define NULL 0
+#endif
+
+#define CACHE_LINE 64
+#define DEFAULT_QUEUE_SIZE 1024
+// a handle is the slot index in the low bits and the slot's generation above it, so a stale handle can be told apart
+#define HANDLE_INDEX_BITS 24
+#define HANDLE_INDEX(handle) ((size_t)((handle) & (CHESS_SESSION_MAX_GAMES - 1)))
+#define HANDLE_GENERATION(handle) ((uint64_t)((handle) >> HANDLE_INDEX_BITS))
+#define MAX_GENERATION UINT32_MAX
+
+typedef enum {
+    COMMAND_MOVE = 0,
+    COMMAND_CLOSE = 1
+} command_kind_t;
+
+// one entry in a shard's queue. sequence says whose turn it is to use the cell
+typedef struct {
+    volatile size_t sequence;
+    chess_session_handle_t handle;
+    chess_index_t from;
+    chess_index_t to;
+    int8_t promotion;
+    uint8_t kind;
+} queue_cell_t;
+
+typedef struct {
+    chess_game_t game;
+    // bumped when the game closes. Only the owning shard's thread writes it
+    uint32_t generation;
+} game_slot_t;
+
+// the producers' end and the consumer's end are kept on separate cache lines
+typedef struct {
+    // claimed by producers
+    volatile size_t tail;
+    char tail_padding[CACHE_LINE - sizeof(size_t)];
+    // owned by the shard's thread. Everything before it has been played
+    volatile size_t head;
+    volatile size_t sleeping;
+    volatile size_t stopping;
+    // how many threads are waiting in chess_session_flush()
+    volatile size_t flushing;
+    queue_cell_t* cells;
+    size_t mask;
+    chess_session_t* session;
+    chess_mutex_t mutex;
+    chess_cond_t signal;
+    chess_thread_t thread;
+    bool running;
+    char head_padding[CACHE_LINE];
+} session_shard_t;
+
+struct chess_session {
+    void* slab_block;
+    uint8_t* slab;
+    size_t slot_size;
+    size_t games;
+    session_shard_t* shards;
+    int shard_count;
+    // the closed slots, taken from the end
+    size_t* free_slots;
+    size_t free_count;
+    chess_mutex_t free_mutex;
+    chess_session_callback_t callback;
+    void* callback_state;
+};
+
+static game_slot_t* slot_at(const chess_session_t* session, size_t index) {
+    return (game_slot_t*)(session->slab + index * session->slot_size);
+}
+
+static session_shard_t* shard_of(const chess_session_t* session, chess_session_handle_t handle) {
+    return &session->shards[HANDLE_INDEX(handle) % (size_t)session->shard_count];
+}
+
+static bool push_command(session_shard_t* shard, chess_session_handle_t handle, chess_index_t from, chess_index_t to, int8_t promotion, command_kind_t kind) {
+    size_t position = chess_atomic_load(&shard->tail);
+    queue_cell_t* cell;
+    while (true) {
+        cell = &shard->cells[position & shard->mask];
+        const size_t sequence = chess_atomic_load(&cell->sequence);
+        if (sequence == position) {
+            if (chess_atomic_compare_exchange(&shard->tail, position, position + 1)) {
+                break;
+            }
+            position = chess_atomic_load(&shard->tail);
+        } else if (sequence < position) {
+            return false;  // full, the consumer hasn't freed this cell yet
+        } else {
+            position = chess_atomic_load(&shard->tail);  // another producer got here first
+        }
+    }
+    cell->handle = handle;
+    cell->from = from;
+    cell->to = to;
+    cell->promotion = promotion;
+    cell->kind = (uint8_t)kind;
+    // publish it
+    chess_atomic_store(&cell->sequence, position + 1);
+    return true;
+}
+
+static void release_slot(chess_session_t* session, size_t index) {
+    chess_mutex_lock(&session->free_mutex);
+    session->free_slots[session->free_count++] = index;
+    chess_mutex_unlock(&session->free_mutex);
+}
+
+static void run_command(chess_session_t* session, const queue_cell_t* cell) {
+    const size_t index = HANDLE_INDEX(cell->handle);
+    game_slot_t* slot = slot_at(session, index);
+    const bool current = slot->generation == HANDLE_GENERATION(cell->handle);
+    if (cell->kind == COMMAND_CLOSE) {
+        if (current) {
+            // wraps back to 1, since generation 0 would make handle 0 valid
+            slot->generation = slot->generation == MAX_GENERATION ? 1 : slot->generation + 1;
+            release_slot(session, index);
+        }
+        return;
+    }
+    chess_session_result_t result;
+    result.handle = cell->handle;
+    result.from = cell->from;
+    result.to = cell->to;
+    result.capture = -2;
+    result.playing = false;
+    result.white_status = CHESS_NORMAL;
+    result.black_status = CHESS_NORMAL;
+    result.game = NULL;
+    if (current) {
+        chess_game_t* game = &slot->game;
+        result.capture = chess_move(game, cell->from, cell->to);
+        if (result.capture != -2 && CHESS_TYPE(game->board[cell->to]) == CHESS_PAWN && (cell->to < 8 || cell->to > 55)) {
+            chess_promote_pawn(game, cell->to, (chess_type_t)cell->promotion);
+        }
+        result.playing = chess_status(game, &result.white_status, &result.black_status);
+        result.game = game;
+    }
+    if (session->callback != NULL) {
+        session->callback(&result, session->callback_state);
+    }
+}
+
+// plays everything waiting on the shard. Returns the number of commands run
+static size_t drain(session_shard_t* shard) {
+    size_t head = shard->head;
+    size_t result = 0;
+    while (true) {
+        queue_cell_t* cell = &shard->cells[head & shard->mask];
+        if (chess_atomic_load(&cell->sequence) != head + 1) {
+            break;
+        }
+        run_command(shard->session, cell);
+        // hand the cell back to the producers, a lap ahead
+        chess_atomic_store(&cell->sequence, head + shard->mask + 1);
+        ++head;
+        chess_atomic_store(&shard->head, head);
+        ++result;
+    }
+    return result;
+}
+
+static bool queue_empty(session_shard_t* shard) {
+    const size_t head = shard->head;
+    return chess_atomic_load(&shard->cells[head & shard->mask].sequence) != head + 1;
+}
+
+static void wake(session_shard_t* shard) {
+    chess_mutex_lock(&shard->mutex);
+    chess_cond_broadcast(&shard->signal);
+    chess_mutex_unlock(&shard->mutex);
+}
+
+static void shard_worker(void* state) {
+    session_shard_t* shard = (session_shard_t*)state;
+    while (true) {
+        if (drain(shard) > 0) {
+            if (chess_atomic_load(&shard->flushing)) {
+                wake(shard);
+            }
+            continue;
+        }
+        chess_mutex_lock(&shard->mutex);
+        // let chess_session_flush() see it's all done
+        chess_cond_broadcast(&shard->signal);
+        chess_atomic_store(&shard->sleeping, 1);
+        // a producer either sees sleeping set, or pushed before this look at the queue
+        if (queue_empty(shard)) {
+            if (chess_atomic_load(&shard->stopping)) {
+                chess_mutex_unlock(&shard->mutex);
+                return;
+            }
+            chess_cond_wait(&shard->signal, &shard->mutex);
+        }
+        chess_atomic_store(&shard->sleeping, 0);
+        chess_mutex_unlock(&shard->mutex);
+    }
+}
+
+// queues a command and gets it played
+static chess_result_t submit(chess_session_t* session, chess_session_handle_t handle, chess_index_t from, chess_index_t to, int8_t promotion, command_kind_t kind) {
+    if (session == NULL || HANDLE_INDEX(handle) >= session->games || HANDLE_GENERATION(handle) == 0) {
+        return CHESS_INVALID;
+    }
+    session_shard_t* shard = shard_of(session, handle);
+    if (!push_command(shard, handle, from, to, promotion, kind)) {
+        return CHESS_BUSY;
+    }
+    if (!shard->running) {
+        // no thread for this shard, so play it here
+        chess_mutex_lock(&shard->mutex);
+        drain(shard);
+        chess_mutex_unlock(&shard->mutex);
+    } else if (chess_atomic_load(&shard->sleeping)) {
+        wake(shard);
+    }
+    return CHESS_SUCCESS;
+}
+
+static void destroy_shards(chess_session_t* session, int count) {
+    for (int i = 0; i < count; ++i) {
+        session_shard_t* shard = &session->shards[i];
+        if (shard->running) {
+            chess_mutex_lock(&shard->mutex);
+            chess_atomic_store(&shard->stopping, 1);
+            chess_cond_broadcast(&shard->signal);
+            chess_mutex_unlock(&shard->mutex);
+            chess_thread_join(shard->thread);
+        }
+        chess_cond_destroy(&shard->signal);
+        chess_mutex_destroy(&shard->mutex);
+        free(shard->cells);
+    }
+}
+
+chess_result_t chess_session_create(const chess_session_config_t* config, chess_session_t** out_session) {
+    if (config == NULL || out_session == NULL || config->games == 0 || config->games > CHESS_SESSION_MAX_GAMES || config->threads < 0) {
+        return CHESS_INVALID;
+    }
+    size_t queue_size = config->queue_size == 0 ? DEFAULT_QUEUE_SIZE : config->queue_size;
+    size_t cells = 2;
+    while (cells < queue_size) {
+        cells <<= 1;
+    }
+    int shard_count = config->threads == 0 ? chess_thread_hardware_count() : config->threads;
+    if ((size_t)shard_count > config->games) {
+        shard_count = (int)config->games;
+    }
+    chess_session_t* session = (chess_session_t*)calloc(1, sizeof(chess_session_t));
+    if (session == NULL) {
+        return CHESS_OUT_OF_MEMORY;
+    }
+    session->games = config->games;
+    session->callback = config->callback;
+    session->callback_state = config->callback_state;
+    session->slot_size = (sizeof(game_slot_t) + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    // one block for every game, aligned so no two games share a cache line
+    session->slab_block = malloc(session->slot_size * config->games + CACHE_LINE);
+    session->free_slots = (size_t*)malloc(config->games * sizeof(size_t));
+    session->shards = (session_shard_t*)calloc((size_t)shard_count, sizeof(session_shard_t));
+    if (session->slab_block == NULL || session->free_slots == NULL || session->shards == NULL) {
+        free(session->shards);
+        free(session->free_slots);
+        free(session->slab_block);
+        free(session);
+        return CHESS_OUT_OF_MEMORY;
+    }
+    session->slab = (uint8_t*)(((uintptr_t)session->slab_block + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+    for (size_t i = 0; i < config->games; ++i) {
+        slot_at(session, i)->generation = 1;
+        // taken from the end, so the first games go to slots 0, 1, 2... and spread over the shards
+        session->free_slots[i] = config->games - 1 - i;
+    }
+    session->free_count = config->games;
+    chess_mutex_init(&session->free_mutex);
+    session->shard_count = shard_count;
+    // the shared tables are filled by the first chess_init(). Doing that here means
+    // concurrent chess_session_open() calls and the shard threads only read them
+    chess_game_t scratch;
+    chess_init(&scratch);
+    for (int i = 0; i < shard_count; ++i) {
+        session_shard_t* shard = &session->shards[i];
+        shard->session = session;
+        shard->mask = cells - 1;
+        shard->cells = (queue_cell_t*)malloc(cells * sizeof(queue_cell_t));
+        chess_mutex_init(&shard->mutex);
+        chess_cond_init(&shard->signal);
+        if (shard->cells == NULL) {
+            destroy_shards(session, i + 1);
+            chess_mutex_destroy(&session->free_mutex);
+            free(session->shards);
+            free(session->free_slots);
+            free(session->slab_block);
+            free(session);
+            return CHESS_OUT_OF_MEMORY;
+        }
+        for (size_t j = 0; j < cells; ++j) {
+            shard->cells[j].sequence = j;
+        }
+    }
+#ifndef CHESS_NO_THREADS
+    for (int i = 0; i < shard_count; ++i) {
+        // a shard without a thread plays its moves on the submitting thread
+        session->shards[i].running = chess_thread_start(&session->shards[i].thread, shard_worker, &session->shards[i]);
+    }
+#endif
+    *out_session = session;
+    return CHESS_SUCCESS;
+}
+
+void chess_session_destroy(chess_session_t* session) {
+    if (session == NULL) {
+        return;
+    }
+    destroy_shards(session, session->shard_count);
+    chess_mutex_destroy(&session->free_mutex);
+    free(session->shards);
+    free(session->free_slots);
+    free(session->slab_block);
+    free(session);
+}
+
+chess_result_t chess_session_open(chess_session_t* session, const chess_game_t* game, chess_session_handle_t* out_handle) {
+    if (session == NULL || out_handle == NULL) {
+        return CHESS_INVALID;
+    }
+    chess_mutex_lock(&session->free_mutex);
+    if (session->free_count == 0) {
+        chess_mutex_unlock(&session->free_mutex);
+        return CHESS_OUT_OF_MEMORY;
+    }
+    const size_t index = session->free_slots[--session->free_count];
+    chess_mutex_unlock(&session->free_mutex);
+    // nothing else touches a free slot, and the first move for it is published through the queue
+    game_slot_t* slot = slot_at(session, index);
+    if (game == NULL) {
+        chess_init(&slot->game);
+    } else {
+        slot->game = *game;
+    }
+    *out_handle = ((chess_session_handle_t)slot->generation << HANDLE_INDEX_BITS) | (chess_session_handle_t)index;
+    return CHESS_SUCCESS;
+}
+
+chess_result_t chess_session_close(chess_session_t* session, chess_session_handle_t handle) {
+    return submit(session, handle, CHESS_NONE, CHESS_NONE, 0, COMMAND_CLOSE);
+}
+
+chess_result_t chess_session_move(chess_session_t* session, chess_session_handle_t handle, chess_index_t index_from, chess_index_t index_to, chess_type_t promotion) {
+    if (index_from < 0 || index_from > 63 || index_to < 0 || index_to > 63) {
+        return CHESS_INVALID;
+    }
+    if (promotion <= CHESS_PAWN || promotion >= CHESS_KING) {
+        promotion = CHESS_QUEEN;
+    }
+    return submit(session, handle, index_from, index_to, (int8_t)promotion, COMMAND_MOVE);
+}
+
+void chess_session_flush(chess_session_t* session) {
+    if (session == NULL) {
+        return;
+    }
+    for (int i = 0; i < session->shard_count; ++i) {
+        session_shard_t* shard = &session->shards[i];
+        const size_t target = chess_atomic_load(&shard->tail);
+        chess_mutex_lock(&shard->mutex);
+        if (!shard->running) {
+            drain(shard);
+        } else {
+            chess_atomic_store(&shard->flushing, chess_atomic_load(&shard->flushing) + 1);
+            while (chess_atomic_load(&shard->head) < target) {
+                chess_cond_wait(&shard->signal, &shard->mutex);
+            }
+            chess_atomic_store(&shard->flushing, chess_atomic_load(&shard->flushing) - 1);
+        }
+        chess_mutex_unlock(&shard->mutex);
+    }
+}
+
+chess_result_t chess_session_game(const chess_session_t* session, chess_session_handle_t handle, chess_game_t* out_game) {
+    if (session == NULL || out_game == NULL || HANDLE_INDEX(handle) >= session->games) {
+        return CHESS_INVALID;
+    }
+    const game_slot_t* slot = slot_at(session, HANDLE_INDEX(handle));
+    if (slot->generation != HANDLE_GENERATION(handle)) {
+        return CHESS_INVALID;
+    }
+    *out_game = slot->game;
+    return CHESS_SUCCESS;
+}
@@ -0,0 +1,266 @@
+// A minimal portable threading layer used internally by htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+#ifndef CHESS_THREAD_H
+#define CHESS_THREAD_H
+#include <stdbool.h>
+#include <stddef.h>
+
+// Win32 and POSIX threads are supported. Anything else, or a build with
+// CHESS_NO_THREADS defined, runs the threaded work on the calling thread.
+#ifndef CHESS_NO_THREADS
+#if defined(_WIN32)
+#define CHESS_THREADS_WIN32
+#elif defined(__unix__) || defined(__APPLE__)
+#define CHESS_THREADS_PTHREAD
+#else
+#define CHESS_NO_THREADS
+#endif
+#endif
+
+#if defined(CHESS_THREADS_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+typedef HANDLE chess_thread_t;
+typedef CRITICAL_SECTION chess_mutex_t;
+typedef CONDITION_VARIABLE chess_cond_t;
+#elif defined(CHESS_THREADS_PTHREAD)
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+typedef pthread_t chess_thread_t;
+typedef pthread_mutex_t chess_mutex_t;
+typedef pthread_cond_t chess_cond_t;
+#else
+typedef int chess_thread_t;
+typedef int chess_mutex_t;
+typedef int chess_cond_t;
+#endif
+
+typedef void (*chess_thread_proc_t)(void* state);
+
+#if defined(CHESS_THREADS_WIN32)
+typedef struct {
+    chess_thread_proc_t proc;
+    void* state;
+} chess_thread_start_t;
+
+static inline DWORD WINAPI chess_thread_entry(LPVOID parameter) {
+    chess_thread_start_t start = *(chess_thread_start_t*)parameter;
+    HeapFree(GetProcessHeap(), 0, parameter);
+    start.proc(start.state);
+    return 0;
+}
+#elif defined(CHESS_THREADS_PTHREAD)
+typedef struct {
+    chess_thread_proc_t proc;
+    void* state;
+} chess_thread_start_t;
+
+static inline void* chess_thread_entry(void* parameter) {
+    chess_thread_start_t start = *(chess_thread_start_t*)parameter;
+    free(parameter);
+    start.proc(start.state);
+    return NULL;
+}
+#endif
+
+// the number of hardware threads, or 1 if that can't be told
+static inline int chess_thread_hardware_count(void) {
+#if defined(CHESS_THREADS_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(CHESS_THREADS_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#else
+    return 1;
+#endif
+}
+
+// starts proc on a new thread. Returns false if threads aren't available or it couldn't start
+static inline bool chess_thread_start(chess_thread_t* out_thread, chess_thread_proc_t proc, void* state) {
+#if defined(CHESS_THREADS_WIN32)
+    chess_thread_start_t* start = (chess_thread_start_t*)HeapAlloc(GetProcessHeap(), 0, sizeof(chess_thread_start_t));
+    if (start == NULL) {
+        return false;
+    }
+    start->proc = proc;
+    start->state = state;
+    *out_thread = CreateThread(NULL, 0, chess_thread_entry, start, 0, NULL);
+    if (*out_thread == NULL) {
+        HeapFree(GetProcessHeap(), 0, start);
+        return false;
+    }
+    return true;
+#elif defined(CHESS_THREADS_PTHREAD)
+    chess_thread_start_t* start = (chess_thread_start_t*)malloc(sizeof(chess_thread_start_t));
+    if (start == NULL) {
+        return false;
+    }
+    start->proc = proc;
+    start->state = state;
+    if (0 != pthread_create(out_thread, NULL, chess_thread_entry, start)) {
+        free(start);
+        return false;
+    }
+    return true;
+#else
+    (void)out_thread;
+    (void)proc;
+    (void)state;
+    return false;
+#endif
+}
+
+static inline void chess_thread_join(chess_thread_t thread) {
+#if defined(CHESS_THREADS_WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_join(thread, NULL);
+#else
+    (void)thread;
+#endif
+}
+
+static inline void chess_mutex_init(chess_mutex_t* mutex) {
+#if defined(CHESS_THREADS_WIN32)
+    InitializeCriticalSection(mutex);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_mutex_init(mutex, NULL);
+#else
+    (void)mutex;
+#endif
+}
+
+static inline void chess_mutex_destroy(chess_mutex_t* mutex) {
+#if defined(CHESS_THREADS_WIN32)
+    DeleteCriticalSection(mutex);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_mutex_destroy(mutex);
+#else
+    (void)mutex;
+#endif
+}
+
+static inline void chess_mutex_lock(chess_mutex_t* mutex) {
+#if defined(CHESS_THREADS_WIN32)
+    EnterCriticalSection(mutex);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_mutex_lock(mutex);
+#else
+    (void)mutex;
+#endif
+}
+
+static inline void chess_mutex_unlock(chess_mutex_t* mutex) {
+#if defined(CHESS_THREADS_WIN32)
+    LeaveCriticalSection(mutex);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_mutex_unlock(mutex);
+#else
+    (void)mutex;
+#endif
+}
+
+static inline void chess_cond_init(chess_cond_t* cond) {
+#if defined(CHESS_THREADS_WIN32)
+    InitializeConditionVariable(cond);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_cond_init(cond, NULL);
+#else
+    (void)cond;
+#endif
+}
+
+static inline void chess_cond_destroy(chess_cond_t* cond) {
+#if defined(CHESS_THREADS_PTHREAD)
+    pthread_cond_destroy(cond);
+#else
+    // nothing to free on Win32
+    (void)cond;
+#endif
+}
+
+static inline void chess_cond_wait(chess_cond_t* cond, chess_mutex_t* mutex) {
+#if defined(CHESS_THREADS_WIN32)
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_cond_wait(cond, mutex);
+#else
+    (void)cond;
+    (void)mutex;
+#endif
+}
+
+static inline void chess_cond_broadcast(chess_cond_t* cond) {
+#if defined(CHESS_THREADS_WIN32)
+    WakeAllConditionVariable(cond);
+#elif defined(CHESS_THREADS_PTHREAD)
+    pthread_cond_broadcast(cond);
+#else
+    (void)cond;
+#endif
+}
+
+// word sized atomics, sequentially consistent, for the few places that can't take a lock
+#if defined(CHESS_THREADS_WIN32) && !(defined(__GNUC__) || defined(__clang__))
+static inline size_t chess_atomic_load(volatile size_t* value) {
+#ifdef _WIN64
+    return (size_t)InterlockedCompareExchange64((volatile LONG64*)value, 0, 0);
+#else
+    return (size_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+#endif
+}
+
+static inline void chess_atomic_store(volatile size_t* value, size_t new_value) {
+#ifdef _WIN64
+    InterlockedExchange64((volatile LONG64*)value, (LONG64)new_value);
+#else
+    InterlockedExchange((volatile LONG*)value, (LONG)new_value);
+#endif
+}
+
+static inline bool chess_atomic_compare_exchange(volatile size_t* value, size_t expected, size_t new_value) {
+#ifdef _WIN64
+    return (LONG64)expected == InterlockedCompareExchange64((volatile LONG64*)value, (LONG64)new_value, (LONG64)expected);
+#else
+    return (LONG)expected == InterlockedCompareExchange((volatile LONG*)value, (LONG)new_value, (LONG)expected);
+#endif
+}
+#elif defined(__GNUC__) || defined(__clang__)
+static inline size_t chess_atomic_load(volatile size_t* value) {
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+static inline void chess_atomic_store(volatile size_t* value, size_t new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+}
+
+static inline bool chess_atomic_compare_exchange(volatile size_t* value, size_t expected, size_t new_value) {
+    return __atomic_compare_exchange_n(value, &expected, new_value, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#else
+// only one thread, so plain reads and writes do
+static inline size_t chess_atomic_load(volatile size_t* value) {
+    return *value;
+}
+
+static inline void chess_atomic_store(volatile size_t* value, size_t new_value) {
+    *value = new_value;
+}
+
+static inline bool chess_atomic_compare_exchange(volatile size_t* value, size_t expected, size_t new_value) {
+    if (*value != expected) {
+        return false;
+    }
+    *value = new_value;
+    return true;
+}
+#endif
+
+#endif // CHESS_THREAD_H
@@ -0,0 +1,137 @@
+#include "chess_tt.h"
+
+#include <memory.h>
+#ifndef NULL
+#define NULL 0
+#endif
+
+// Each slot holds the key XOR the data alongside the data. Threads read and
+// write both words without a lock. If a reader sees half of one store and half
+// of another, the pair no longer XORs back to the key and the probe misses,
+// which is the same as the entry never having been there.
+#if (defined(__GNUC__) || defined(__clang__)) && UINTPTR_MAX > 0xFFFFFFFFu
+#define SLOT_LOAD(word) __atomic_load_n(&(word), __ATOMIC_RELAXED)
+#define SLOT_STORE(word, value) __atomic_store_n(&(word), (value), __ATOMIC_RELAXED)
+#else
+// a torn 64-bit access simply fails the check
+#define SLOT_LOAD(word) (*(volatile uint64_t*)&(word))
+#define SLOT_STORE(word, value) (*(volatile uint64_t*)&(word) = (value))
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)
+#else
+#define PREFETCH(address)
+#endif
+
+// data layout:
+// bits 0-31 value, 32-47 move, 48-55 depth, 56-57 bound, 58 in use, 59-63 age
+#define DATA_USED (((uint64_t)1) << 58)
+#define DATA_AGE(data) ((uint8_t)((data) >> 59))
+#define AGE_MASK 31
+
+static uint64_t pack_entry(const chess_tt_entry_t* entry, uint8_t age) {
+    return (uint64_t)(uint32_t)entry->value |
+           ((uint64_t)entry->move << 32) |
+           ((uint64_t)entry->depth << 48) |
+           ((uint64_t)(entry->bound & 3) << 56) |
+           DATA_USED |
+           ((uint64_t)(age & AGE_MASK) << 59);
+}
+
+static void unpack_entry(uint64_t data, chess_tt_entry_t* out_entry) {
+    out_entry->value = (int32_t)(uint32_t)data;
+    out_entry->move = (chess_move_t)(data >> 32);
+    out_entry->depth = (uint8_t)(data >> 48);
+    out_entry->bound = (chess_tt_bound_t)((data >> 56) & 3);
+}
+
+// a key maps to a bucket of two neighboring slots, which share a cache line
+static chess_tt_slot_t* bucket_of(const chess_tt_t* tt, uint64_t key) {
+    return &tt->slots[(size_t)key & tt->mask & ~(size_t)1];
+}
+
+chess_result_t chess_tt_init(chess_tt_t* out_tt, void* buffer, size_t size) {
+    if (out_tt == NULL || buffer == NULL || size < 2 * sizeof(chess_tt_slot_t)) {
+        return CHESS_INVALID;
+    }
+    size_t count = 2;
+    while (count <= size / sizeof(chess_tt_slot_t) / 2) {
+        count *= 2;
+    }
+    out_tt->slots = (chess_tt_slot_t*)buffer;
+    out_tt->mask = count - 1;
+    out_tt->age = 0;
+    chess_tt_clear(out_tt);
+    return CHESS_SUCCESS;
+}
+
+void chess_tt_clear(chess_tt_t* tt) {
+    if (tt == NULL || tt->slots == NULL) {
+        return;
+    }
+    memset(tt->slots, 0, (tt->mask + 1) * sizeof(chess_tt_slot_t));
+}
+
+void chess_tt_new_search(chess_tt_t* tt) {
+    if (tt == NULL) {
+        return;
+    }
+    tt->age = (tt->age + 1) & AGE_MASK;
+}
+
+void chess_tt_prefetch(const chess_tt_t* tt, uint64_t key) {
+    if (tt == NULL || tt->slots == NULL) {
+        return;
+    }
+    PREFETCH(bucket_of(tt, key));
+}
+
+bool chess_tt_probe(const chess_tt_t* tt, uint64_t key, chess_tt_entry_t* out_entry) {
+    if (tt == NULL || tt->slots == NULL || out_entry == NULL) {
+        return false;
+    }
+    chess_tt_slot_t* bucket = bucket_of(tt, key);
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t data = SLOT_LOAD(bucket[i].data);
+        const uint64_t check = SLOT_LOAD(bucket[i].check);
+        if ((data & DATA_USED) && (check ^ data) == key) {
+            unpack_entry(data, out_entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+void chess_tt_store(chess_tt_t* tt, uint64_t key, const chess_tt_entry_t* entry) {
+    if (tt == NULL || tt->slots == NULL || entry == NULL) {
+        return;
+    }
+    chess_tt_slot_t* bucket = bucket_of(tt, key);
+    chess_tt_slot_t* victim = NULL;
+    int victim_worth = 0;
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t data = SLOT_LOAD(bucket[i].data);
+        const uint64_t check = SLOT_LOAD(bucket[i].check);
+        if ((data & DATA_USED) && (check ^ data) == key) {
+            // same position. Newer results win
+            victim = &bucket[i];
+            break;
+        }
+        // empty slots go first, then entries from older searches, then the shallowest
+        int worth = -2;
+        if (data & DATA_USED) {
+            worth = DATA_AGE(data) == tt->age ? (int)(uint8_t)(data >> 48) : -1;
+        }
+        if (victim == NULL || worth < victim_worth) {
+            victim = &bucket[i];
+            victim_worth = worth;
+        }
+    }
+    const uint64_t data = pack_entry(entry, tt->age);
+    SLOT_STORE(victim->check, key ^ data);
+    SLOT_STORE(victim->data, data);
+}
@@ -0,0 +1,415 @@
+// Micro-benchmarks for the htcw_chess API
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+//
+// Times each public entry point over a corpus of opening, middlegame and
+// endgame positions. On Linux it also reads cycles, instructions and branch
+// misses from the hardware counters, when the kernel allows it.
+//
+// usage: htcw_chess_bench [--json] [--iterations N]
+#include "chess.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define CORPUS_SIZE 64
+#define PHASE_COUNT 3
+
+typedef struct {
+    chess_game_t game;
+    // the same position, to time chess_unpack() with
+    chess_packed_t packed;
+    // a legal move to time chess_move() with
+    chess_index_t from;
+    chess_index_t to;
+} bench_position_t;
+
+typedef struct {
+    bench_position_t positions[CORPUS_SIZE];
+    size_t size;
+} corpus_t;
+
+static const char* phase_names[PHASE_COUNT] = {"opening", "middlegame", "endgame"};
+static corpus_t phases[PHASE_COUNT];
+// positions with a pawn waiting to be promoted, and the index of the pawn
+static corpus_t promotions;
+static chess_index_t promotion_indices[CORPUS_SIZE];
+// chess_status() by piece count
+static corpus_t by_pieces[33];
+
+static volatile size_t sink;
+
+static unsigned long long random_state = 0x2545F4914F6CDD1DULL;
+static unsigned int next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return (unsigned int)(random_state >> 32);
+}
+
+static int count_pieces(const chess_game_t* game) {
+    int result = 0;
+    for (chess_index_t i = 0; i < 64; ++i) {
+        if (chess_index_to_id(game, i) != CHESS_NONE) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+static void add_position(corpus_t* corpus, const chess_game_t* game, chess_move_t move) {
+    if (corpus->size < CORPUS_SIZE) {
+        bench_position_t* position = &corpus->positions[corpus->size++];
+        position->game = *game;
+        chess_pack(game, &position->packed);
+        position->from = CHESS_MOVE_FROM(move);
+        position->to = CHESS_MOVE_TO(move);
+    }
+}
+
+// fills the corpora from seeded random games, so every run times the same positions
+static void build_corpus(void) {
+    for (int games = 0; games < 2000; ++games) {
+        chess_game_t game;
+        chess_init(&game);
+        for (int ply = 0; ply < 400; ++ply) {
+            chess_move_list_t moves;
+            if (0 == chess_generate_moves(&game, &moves)) {
+                break;
+            }
+            const chess_move_t move = moves.moves[next_random() % moves.size];
+            const int pieces = count_pieces(&game);
+            const int phase = pieces >= 28 ? 0 : pieces >= 14 ? 1 : 2;
+            if (next_random() % 8 == 0) {
+                add_position(&phases[phase], &game, move);
+                add_position(&by_pieces[pieces], &game, move);
+            }
+            if (CHESS_MOVE_PROMOTION(move) != CHESS_NONE && promotions.size < CORPUS_SIZE) {
+                // chess_move() leaves the pawn on the last rank for chess_promote_pawn()
+                chess_game_t pending = game;
+                chess_move(&pending, CHESS_MOVE_FROM(move), CHESS_MOVE_TO(move));
+                promotion_indices[promotions.size] = CHESS_MOVE_TO(move);
+                add_position(&promotions, &pending, move);
+            }
+            chess_make_move(&game, move, NULL);
+        }
+    }
+}
+
+typedef struct {
+    bool enabled;
+#ifdef __linux__
+    int fds[3];
+#endif
+} counters_t;
+
+typedef struct {
+    unsigned long long cycles;
+    unsigned long long instructions;
+    unsigned long long branch_misses;
+} counter_values_t;
+
+static void counters_open(counters_t* counters) {
+    counters->enabled = false;
+#ifdef __linux__
+    static const unsigned long long configs[3] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES};
+    int leader = -1;
+    for (int i = 0; i < 3; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (counters->fds[i] < 0) {
+            // not supported or not permitted. Timings only
+            for (int j = 0; j < i; ++j) {
+                close(counters->fds[j]);
+            }
+            return;
+        }
+        if (i == 0) {
+            leader = counters->fds[0];
+        }
+    }
+    counters->enabled = true;
+#endif
+}
+
+static void counters_close(counters_t* counters) {
+#ifdef __linux__
+    if (counters->enabled) {
+        for (int i = 0; i < 3; ++i) {
+            close(counters->fds[i]);
+        }
+    }
+#endif
+    counters->enabled = false;
+}
+
+static void counters_start(counters_t* counters) {
+#ifdef __linux__
+    if (counters->enabled) {
+        ioctl(counters->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(counters->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    (void)counters;
+#endif
+}
+
+static void counters_stop(counters_t* counters, counter_values_t* out_values) {
+    memset(out_values, 0, sizeof(*out_values));
+#ifdef __linux__
+    if (counters->enabled) {
+        unsigned long long group[4];
+        ioctl(counters->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if (read(counters->fds[0], group, sizeof(group)) == (ssize_t)sizeof(group) && group[0] == 3) {
+            out_values->cycles = group[1];
+            out_values->instructions = group[2];
+            out_values->branch_misses = group[3];
+        }
+    }
+#else
+    (void)counters;
+#endif
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+typedef void (*bench_op_t)(bench_position_t* position, size_t index);
+
+static void op_move(bench_position_t* position, size_t index) {
+    (void)index;
+    chess_game_t game = position->game;
+    sink += (size_t)chess_move(&game, position->from, position->to);
+}
+
+static void op_compute_moves(bench_position_t* position, size_t index) {
+    (void)index;
+    chess_index_t moves[64];
+    size_t result = 0;
+    for (chess_index_t i = 0; i < 64; ++i) {
+        const chess_id_t id = chess_index_to_id(&position->game, i);
+        if (id != CHESS_NONE && CHESS_TEAM(id) == chess_turn(&position->game)) {
+            result += chess_compute_moves(&position->game, i, moves);
+        }
+    }
+    sink += result;
+}
+
+static void op_legal_destination_map(bench_position_t* position, size_t index) {
+    (void)index;
+    uint64_t masks[64];
+    sink += chess_legal_destination_map(&position->game, masks);
+}
+
+static void op_status(bench_position_t* position, size_t index) {
+    (void)index;
+    chess_status_t white, black;
+    sink += chess_status(&position->game, &white, &black);
+}
+
+static void op_has_legal_move(bench_position_t* position, size_t index) {
+    (void)index;
+    sink += chess_has_legal_move(&position->game);
+}
+
+static void op_count_legal_moves(bench_position_t* position, size_t index) {
+    (void)index;
+    sink += chess_count_legal_moves(&position->game);
+}
+
+static void op_pack(bench_position_t* position, size_t index) {
+    (void)index;
+    chess_packed_t packed;
+    chess_pack(&position->game, &packed);
+    sink += packed.bytes[CHESS_PACKED_SIZE - 1];
+}
+
+static void op_unpack(bench_position_t* position, size_t index) {
+    (void)index;
+    chess_game_t game;
+    chess_unpack(&game, &position->packed);
+    sink += (size_t)chess_hash(&game);
+}
+
+static void op_evaluate(bench_position_t* position, size_t index) {
+    (void)index;
+    sink += (size_t)chess_evaluate(&position->game);
+}
+
+static void op_see(bench_position_t* position, size_t index) {
+    (void)index;
+    sink += (size_t)chess_see(&position->game, position->from, position->to);
+}
+
+static void op_promote_pawn(bench_position_t* position, size_t index) {
+    chess_game_t game = position->game;
+    sink += (size_t)chess_promote_pawn(&game, promotion_indices[index], CHESS_QUEEN);
+}
+
+static void op_can_castle(bench_position_t* position, size_t index) {
+    (void)index;
+    sink += chess_can_castle(&position->game, chess_turn(&position->game));
+}
+
+typedef struct {
+    double ns_per_op;
+    double cycles_per_op;
+    double instructions_per_op;
+    double branch_misses_per_op;
+} bench_result_t;
+
+static void run(counters_t* counters, corpus_t* corpus, bench_op_t op, int iterations, bench_result_t* out_result) {
+    memset(out_result, 0, sizeof(*out_result));
+    if (corpus->size == 0) {
+        return;
+    }
+    // warm up the caches and the branch predictors
+    for (size_t i = 0; i < corpus->size; ++i) {
+        op(&corpus->positions[i], i);
+    }
+    counter_values_t values;
+    const double start = now_seconds();
+    counters_start(counters);
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        for (size_t i = 0; i < corpus->size; ++i) {
+            op(&corpus->positions[i], i);
+        }
+    }
+    counters_stop(counters, &values);
+    const double elapsed = now_seconds() - start;
+    const double ops = (double)iterations * (double)corpus->size;
+    out_result->ns_per_op = elapsed * 1e9 / ops;
+    out_result->cycles_per_op = (double)values.cycles / ops;
+    out_result->instructions_per_op = (double)values.instructions / ops;
+    out_result->branch_misses_per_op = (double)values.branch_misses / ops;
+}
+
+static void print_result(bool json, bool counters_enabled, bool* first, const char* name, const char* phase,
+                         const corpus_t* corpus, const bench_result_t* result) {
+    if (json) {
+        printf("%s\n    {\"name\": \"%s\", \"phase\": \"%s\", \"positions\": %u, \"ns_per_op\": %.2f",
+               *first ? "" : ",", name, phase, (unsigned)corpus->size, result->ns_per_op);
+        if (counters_enabled) {
+            printf(", \"cycles_per_op\": %.2f, \"instructions_per_op\": %.2f, \"branch_misses_per_op\": %.3f",
+                   result->cycles_per_op, result->instructions_per_op, result->branch_misses_per_op);
+        }
+        printf("}");
+    } else {
+        printf("%-27s %-11s %4u %10.1f", name, phase, (unsigned)corpus->size, result->ns_per_op);
+        if (counters_enabled) {
+            printf(" %10.1f %10.1f %8.3f", result->cycles_per_op, result->instructions_per_op,
+                   result->branch_misses_per_op);
+        }
+        printf("\n");
+    }
+    *first = false;
+}
+
+int main(int argc, char** argv) {
+    bool json = false;
+    int iterations = 2000;
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "--json")) {
+            json = true;
+        } else if (0 == strcmp(argv[i], "--iterations") && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: htcw_chess_bench [--json] [--iterations N]\n");
+            return 2;
+        }
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+    build_corpus();
+    counters_t counters;
+    counters_open(&counters);
+
+    static const struct {
+        const char* name;
+        bench_op_t op;
+    } ops[] = {
+        {"chess_move", op_move},
+        {"chess_compute_moves", op_compute_moves},
+        {"chess_legal_destination_map", op_legal_destination_map},
+        {"chess_status", op_status},
+        {"chess_has_legal_move", op_has_legal_move},
+        {"chess_count_legal_moves", op_count_legal_moves},
+        {"chess_can_castle", op_can_castle},
+        {"chess_pack", op_pack},
+        {"chess_unpack", op_unpack},
+        {"chess_see", op_see},
+        {"chess_evaluate", op_evaluate},
+    };
+    bench_result_t result;
+    bool first = true;
+    if (json) {
+        printf("{\n  \"iterations\": %d,\n  \"counters\": %s,\n  \"benchmarks\": [", iterations,
+               counters.enabled ? "true" : "false");
+    } else {
+        printf("%-27s %-11s %4s %10s", "function", "phase", "pos", "ns/op");
+        if (counters.enabled) {
+            printf(" %10s %10s %8s", "cycles", "instrs", "br-miss");
+        }
+        printf("\n");
+    }
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+        for (int phase = 0; phase < PHASE_COUNT; ++phase) {
+            run(&counters, &phases[phase], ops[i].op, iterations, &result);
+            print_result(json, counters.enabled, &first, ops[i].name, phase_names[phase], &phases[phase], &result);
+        }
+    }
+    run(&counters, &promotions, op_promote_pawn, iterations, &result);
+    print_result(json, counters.enabled, &first, "chess_promote_pawn", "any", &promotions, &result);
+
+    // chess_status() latency by the number of pieces on the board
+    first = true;
+    if (json) {
+        printf("\n  ],\n  \"status_by_pieces\": [");
+    } else {
+        printf("\nchess_status by piece count\n%6s %4s %10s\n", "pieces", "pos", "ns/op");
+    }
+    for (int pieces = 32; pieces >= 2; --pieces) {
+        if (by_pieces[pieces].size == 0) {
+            continue;
+        }
+        run(&counters, &by_pieces[pieces], op_status, iterations, &result);
+        if (json) {
+            printf("%s\n    {\"pieces\": %d, \"positions\": %u, \"ns_per_op\": %.2f", first ? "" : ",", pieces,
+                   (unsigned)by_pieces[pieces].size, result.ns_per_op);
+            if (counters.enabled) {
+                printf(", \"cycles_per_op\": %.2f", result.cycles_per_op);
+            }
+            printf("}");
+        } else {
+            printf("%6d %4u %10.1f\n", pieces, (unsigned)by_pieces[pieces].size, result.ns_per_op);
+        }
+        first = false;
+    }
+    if (json) {
+        printf("\n  ]\n}\n");
+    }
+    counters_close(&counters);
+    return 0;
+}
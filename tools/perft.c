@@ -0,0 +1,230 @@
+// Perft driver for htcw_chess
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+//
+// Counts the leaf nodes of the move tree to a given depth, which is the usual
+// way to check a move generator and to measure its speed.
+//
+// usage: htcw_chess_perft [--divide] [--depth N] [--threads N] [--fen FEN] [move ...]
+//        htcw_chess_perft [--threads N] --verify
+//
+// Moves are played from the --fen position, or the start position, and are
+// given as from and to squares, such as e2e4, with a trailing q, r, b or n
+// for promotions. A castle is the king moving two squares, such as e1g1.
+// --threads 0, the default, uses one thread per hardware thread.
+// --verify also checks chess_see() on a few exchanges.
+#include "chess.h"
+#include "chess_perft.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    const char* name;
+    // the position to start from, or NULL for the start position
+    const char* fen;
+    // moves played from there, separated by spaces
+    const char* moves;
+    int depth;
+    unsigned long long nodes;
+} perft_case_t;
+
+// The start position and the FEN positions use the published counts. The
+// move list cases were cross-checked against other move generators.
+static const perft_case_t verify_cases[] = {
+    {"start", NULL, "", 1, 20ULL},
+    {"start", NULL, "", 2, 400ULL},
+    {"start", NULL, "", 3, 8902ULL},
+    {"start", NULL, "", 4, 197281ULL},
+    {"start", NULL, "", 5, 4865609ULL},
+    {"en passant", NULL, "e2e4 d7d5 e4e5 f7f5", 4, 524138ULL},
+    {"castling", NULL, "e2e4 e7e5 g1f3 b8c6 f1c4 g8f6", 4, 914790ULL},
+    {"pins", NULL, "d2d4 d7d5 c1f4 g8f6 e2e3 e7e6 b1c3 f8b4", 4, 1483073ULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", "", 4, 4085603ULL},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", "", 5, 674624ULL},
+    {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", "", 4, 422333ULL},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", "", 4, 2103487ULL},
+};
+
+typedef struct {
+    const char* fen;
+    // the capture to evaluate, as from and to squares like d4e5
+    const char* move;
+    int score;
+} see_case_t;
+
+// Static exchange results in chess_type_score() units, worked out by hand.
+// The first one needs the knight to recapture before the rook.
+static const see_case_t see_cases[] = {
+    {"k3r3/5n2/8/4n3/3B4/5N2/8/K7 w - - 0 1", "d4e5", 0},
+    {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 1},
+    {"4k3/8/3p4/4n3/3P4/8/8/4K3 w - - 0 1", "d4e5", 2},
+    {"4k3/8/3p4/4n3/8/8/4R3/4K3 w - - 0 1", "e2e5", -2},
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void move_name(chess_move_t move, char* out_buffer) {
+    static const char promotions[] = "pbrnqk";
+    chess_index_name(CHESS_MOVE_FROM(move), out_buffer);
+    chess_index_name(CHESS_MOVE_TO(move), out_buffer + 2);
+    const chess_value_t promotion = CHESS_MOVE_PROMOTION(move);
+    out_buffer[4] = promotion == CHESS_NONE ? '\0' : promotions[promotion];
+    out_buffer[5] = '\0';
+}
+
+// plays a move like e2e4 or a7a8q if it's legal in the current position
+static bool play_move(chess_game_t* game, const char* text) {
+    chess_move_list_t moves;
+    chess_generate_moves(game, &moves);
+    for (size_t i = 0; i < moves.size; ++i) {
+        char name[6];
+        move_name(moves.moves[i], name);
+        if (0 == strcmp(name, text)) {
+            chess_make_move(game, moves.moves[i], NULL);
+            return true;
+        }
+    }
+    return false;
+}
+
+// loads a position, or the start position if fen is NULL, and plays a space separated move list from there
+static bool setup(chess_game_t* game, const char* fen, const char* moves) {
+    if (fen == NULL) {
+        chess_init(game);
+    } else if (CHESS_SUCCESS != chess_from_fen(game, fen)) {
+        fprintf(stderr, "bad FEN %s\n", fen);
+        return false;
+    }
+    char text[8];
+    while (*moves) {
+        size_t length = strcspn(moves, " ");
+        if (length > 0) {
+            if (length >= sizeof(text)) {
+                return false;
+            }
+            memcpy(text, moves, length);
+            text[length] = '\0';
+            if (!play_move(game, text)) {
+                fprintf(stderr, "illegal move %s\n", text);
+                return false;
+            }
+        }
+        moves += length;
+        if (*moves == ' ') {
+            ++moves;
+        }
+    }
+    return true;
+}
+
+static unsigned long long divide(const chess_game_t* game, int depth, int threads) {
+    chess_move_list_t moves;
+    unsigned long long counts[CHESS_MAX_MOVES];
+    const unsigned long long result = chess_perft_divide(game, depth, threads, &moves, counts);
+    for (size_t i = 0; i < moves.size; ++i) {
+        char name[6];
+        move_name(moves.moves[i], name);
+        printf("%s: %llu\n", name, counts[i]);
+    }
+    printf("\n");
+    return result;
+}
+
+static int verify(int threads) {
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(verify_cases) / sizeof(verify_cases[0]); ++i) {
+        const perft_case_t* test = &verify_cases[i];
+        chess_game_t game;
+        if (!setup(&game, test->fen, test->moves)) {
+            printf("%-12s depth %d: bad setup\n", test->name, test->depth);
+            ++failures;
+            continue;
+        }
+        const double start = now_seconds();
+        const unsigned long long nodes = chess_perft(&game, test->depth, threads);
+        const double elapsed = now_seconds() - start;
+        const bool passed = nodes == test->nodes;
+        printf("%-12s depth %d: %llu nodes %s (%.3fs)\n", test->name, test->depth, nodes,
+               passed ? "ok" : "FAILED", elapsed);
+        if (!passed) {
+            printf("    expected %llu\n", test->nodes);
+            ++failures;
+        }
+    }
+    for (size_t i = 0; i < sizeof(see_cases) / sizeof(see_cases[0]); ++i) {
+        const see_case_t* test = &see_cases[i];
+        chess_game_t game;
+        const chess_index_t from = (chess_index_t)((test->move[1] - '1') * 8 + (test->move[0] - 'a'));
+        const chess_index_t to = (chess_index_t)((test->move[3] - '1') * 8 + (test->move[2] - 'a'));
+        if (CHESS_SUCCESS != chess_from_fen(&game, test->fen)) {
+            printf("see %s: bad setup\n", test->move);
+            ++failures;
+            continue;
+        }
+        const int score = chess_see(&game, from, to);
+        printf("see %s: %d %s\n", test->move, score, score == test->score ? "ok" : "FAILED");
+        if (score != test->score) {
+            printf("    expected %d\n", test->score);
+            ++failures;
+        }
+    }
+    printf("%d failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: htcw_chess_perft [--divide] [--depth N] [--threads N] [--fen FEN] [move ...]\n"
+            "       htcw_chess_perft [--threads N] --verify\n");
+}
+
+int main(int argc, char** argv) {
+    int depth = 5;
+    int threads = 0;
+    bool show_divide = false;
+    chess_game_t game;
+    chess_init(&game);
+    for (int i = 1; i < argc; ++i) {
+        if (0 == strcmp(argv[i], "--verify")) {
+            return verify(threads);
+        } else if (0 == strcmp(argv[i], "--divide")) {
+            show_divide = true;
+        } else if (0 == strcmp(argv[i], "--depth") && i + 1 < argc) {
+            depth = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (0 == strcmp(argv[i], "--fen") && i + 1 < argc) {
+            // moves before it are dropped, since they were played from the start position
+            if (CHESS_SUCCESS != chess_from_fen(&game, argv[++i])) {
+                fprintf(stderr, "bad FEN %s\n", argv[i]);
+                return 2;
+            }
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else if (!play_move(&game, argv[i])) {
+            fprintf(stderr, "illegal move %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (depth < 1 || threads < 0) {
+        usage();
+        return 2;
+    }
+    const double start = now_seconds();
+    const unsigned long long nodes = show_divide ? divide(&game, depth, threads) : chess_perft(&game, depth, threads);
+    const double elapsed = now_seconds() - start;
+    printf("depth %d: %llu nodes in %.3fs", depth, nodes, elapsed);
+    if (elapsed > 0) {
+        printf(" (%.0f nodes/s)", (double)nodes / elapsed);
+    }
+    printf("\n");
+    return 0;
+}
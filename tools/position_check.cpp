@@ -0,0 +1,92 @@
+// Cross-check of chess.hpp against the C library
+// copyright (c) 2025 by honey the codewitch
+// MIT license
+//
+// Walks the move tree of the standard perft positions, and at every node
+// compares the moves from htcw::chess::position::generate() with those from
+// chess_generate_moves(), and position::attacked() with chess_is_attacked()
+// on every square. The leaf counts are checked against the published ones.
+//
+// usage: htcw_chess_position_check
+#include "chess.hpp"
+
+#include <stdio.h>
+
+#include <algorithm>
+
+using htcw::chess::position;
+
+namespace {
+struct check_case_t {
+    const char* name;
+    const char* fen;
+    int depth;
+    unsigned long long nodes;
+};
+
+const check_case_t check_cases[] = {
+    {"start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281ULL},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862ULL},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624ULL},
+    {"position 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3, 9467ULL},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379ULL},
+};
+
+// the number of nodes where the two sides disagreed
+unsigned long long mismatches;
+
+// compares the two move sets, which needn't be in the same order, and the attacked squares
+void compare(const position& pos, chess_move_list_t& moves) {
+    chess_move_list_t reference;
+    pos.generate(moves);
+    chess_generate_moves(&pos.game(), &reference);
+    std::sort(moves.moves, moves.moves + moves.size);
+    std::sort(reference.moves, reference.moves + reference.size);
+    bool same = moves.size == reference.size && std::equal(moves.moves, moves.moves + moves.size, reference.moves);
+    for (chess_index_t index = 0; same && index < 64; ++index) {
+        same = pos.attacked(index, CHESS_WHITE) == chess_is_attacked(&pos.game(), index, CHESS_WHITE) &&
+               pos.attacked(index, CHESS_BLACK) == chess_is_attacked(&pos.game(), index, CHESS_BLACK);
+    }
+    if (!same) {
+        ++mismatches;
+    }
+}
+
+unsigned long long walk(position& pos, int depth) {
+    chess_move_list_t moves;
+    compare(pos, moves);
+    if (depth == 1) {
+        return moves.size;
+    }
+    unsigned long long result = 0;
+    for (size_t i = 0; i < moves.size; ++i) {
+        chess_undo_t undo;
+        pos.make(moves.moves[i], &undo);
+        result += walk(pos, depth - 1);
+        pos.unmake(undo);
+    }
+    return result;
+}
+}  // namespace
+
+int main() {
+    int failures = 0;
+    for (const check_case_t& test : check_cases) {
+        position pos;
+        if (CHESS_SUCCESS != pos.fen(test.fen)) {
+            printf("%-12s bad setup\n", test.name);
+            ++failures;
+            continue;
+        }
+        mismatches = 0;
+        const unsigned long long nodes = walk(pos, test.depth);
+        const bool passed = nodes == test.nodes && mismatches == 0;
+        printf("%-12s depth %d: %llu nodes, %llu mismatched %s\n", test.name, test.depth, nodes, mismatches,
+               passed ? "ok" : "FAILED");
+        if (!passed) {
+            ++failures;
+        }
+    }
+    printf("%d failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}